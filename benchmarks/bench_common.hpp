@@ -0,0 +1,282 @@
+#ifndef TRY_CATCH_GUARD_BENCH_COMMON_HPP
+#define TRY_CATCH_GUARD_BENCH_COMMON_HPP
+
+// Shared helpers for the TryCatchGuard benchmark executables: timing, result
+// collection, command line parsing and JSON output.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace try_catch_guard {
+namespace bench {
+
+// Prevents the compiler from optimizing away a value that is computed only for the benchmark
+template <typename T>
+inline void doNotOptimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Forces the compiler to assume that memory has been read and written
+inline void clobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+inline std::uint64_t nowNs()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// One named measurement; all times are nanoseconds per operation
+struct BenchResult {
+    std::string name;
+    std::string group;
+    double median_ns = 0.0;
+    double min_ns = 0.0;
+    double max_ns = 0.0;
+    std::uint64_t iterations = 0;
+    std::uint64_t repeats = 0;
+    // Optional extra numeric fields (e.g. "depth", "threads")
+    std::vector<std::pair<std::string, double>> extra;
+};
+
+// Options shared by all benchmark executables
+struct BenchOptions {
+    std::string json_path;      // Empty means stdout
+    std::string filter;         // Substring that a benchmark name must contain
+    std::uint64_t iterations = 0; // 0 means the benchmark default
+    std::uint64_t repeats = 5;
+    bool quick = false;         // Reduce the amount of work (smoke runs)
+    int cpu = -1;               // CPU to pin the benchmark to, -1 means no pinning
+};
+
+inline void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--json <file>] [--filter <substring>] [--iterations <n>] [--repeats <n>] [--quick] [--cpu <n>]"
+              << std::endl;
+}
+
+// Affinity mask of the process before pinning, used to unpin worker threads
+inline cpu_set_t& originalAffinity()
+{
+    static cpu_set_t mask = [] {
+        cpu_set_t initial;
+        CPU_ZERO(&initial);
+        sched_getaffinity(0, sizeof(initial), &initial);
+        return initial;
+    }();
+    return mask;
+}
+
+// Pins the calling thread (and the threads it creates afterwards) to one CPU
+inline bool pinToCpu(int cpu)
+{
+    originalAffinity();
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+    {
+        std::cerr << "Failed to pin to CPU " << cpu << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Lets a worker thread run on every CPU the process was allowed to use
+inline void restoreThreadAffinity()
+{
+    sched_setaffinity(0, sizeof(cpu_set_t), &originalAffinity());
+}
+
+inline bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--iterations" && has_value) {
+            options.iterations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeats" && has_value) {
+            options.repeats = std::max<std::uint64_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--quick") {
+            options.quick = true;
+        } else if (arg == "--cpu" && has_value) {
+            options.cpu = std::atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.cpu >= 0 && !pinToCpu(options.cpu)) {
+        return false;
+    }
+    return true;
+}
+
+// `name` is "group/name"; the filter selects benchmarks whose path contains it
+inline bool isSelected(const BenchOptions& options, const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+inline BenchResult summarize(const std::string& group, const std::string& name,
+                             std::vector<double> samples, std::uint64_t iterations)
+{
+    BenchResult result;
+    result.group = group;
+    result.name = name;
+    result.iterations = iterations;
+    result.repeats = samples.size();
+
+    if (!samples.empty())
+    {
+        std::sort(samples.begin(), samples.end());
+        result.min_ns = samples.front();
+        result.max_ns = samples.back();
+        result.median_ns = samples[samples.size() / 2];
+    }
+    return result;
+}
+
+// Runs op() `iterations` times per repeat and reports nanoseconds per call.
+// One untimed warm-up repeat is executed first.
+template <typename Op>
+BenchResult measure(const std::string& group, const std::string& name,
+                    std::uint64_t iterations, std::uint64_t repeats, Op&& op)
+{
+    for (std::uint64_t i = 0; i < iterations / 10 + 1; ++i) {
+        op();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(repeats);
+
+    for (std::uint64_t r = 0; r < repeats; ++r)
+    {
+        std::uint64_t start = nowNs();
+        for (std::uint64_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        std::uint64_t elapsed = nowNs() - start;
+        samples.push_back(static_cast<double>(elapsed) / static_cast<double>(iterations));
+    }
+
+    return summarize(group, name, std::move(samples), iterations);
+}
+
+// Returns the extra field `key` of a result, or `fallback` when it is missing
+inline double extraValue(const BenchResult& result, const std::string& key, double fallback = 0.0)
+{
+    for (const auto& field : result.extra)
+    {
+        if (field.first == key) {
+            return field.second;
+        }
+    }
+    return fallback;
+}
+
+inline std::string jsonEscape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+inline std::string compilerId()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// Writes all results as a single JSON document:
+// { "benchmark": ..., "compiler": ..., "timestamp": ..., "results": [ {...}, ... ] }
+inline void writeJson(std::ostream& out, const std::string& benchmark, const std::vector<BenchResult>& results)
+{
+    out << "{\n";
+    out << "  \"benchmark\": \"" << jsonEscape(benchmark) << "\",\n";
+    out << "  \"compiler\": \"" << jsonEscape(compilerId()) << "\",\n";
+    out << "  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n";
+    out << "  \"results\": [\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        out << "    { \"group\": \"" << jsonEscape(r.group) << "\""
+            << ", \"name\": \"" << jsonEscape(r.name) << "\""
+            << ", \"median_ns\": " << r.median_ns
+            << ", \"min_ns\": " << r.min_ns
+            << ", \"max_ns\": " << r.max_ns
+            << ", \"iterations\": " << r.iterations
+            << ", \"repeats\": " << r.repeats;
+        for (const auto& field : r.extra) {
+            out << ", \"" << jsonEscape(field.first) << "\": " << field.second;
+        }
+        out << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// Writes the results to options.json_path (or stdout) and a short table to stderr
+inline int emitResults(const BenchOptions& options, const std::string& benchmark, const std::vector<BenchResult>& results)
+{
+    for (const BenchResult& r : results)
+    {
+        std::cerr << "  " << r.group << "/" << r.name << ": " << r.median_ns << " ns/op"
+                  << " (min " << r.min_ns << ", max " << r.max_ns << ")" << std::endl;
+    }
+
+    if (options.json_path.empty())
+    {
+        writeJson(std::cout, benchmark, results);
+        return 0;
+    }
+
+    std::ofstream file(options.json_path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << options.json_path << " for writing" << std::endl;
+        return 1;
+    }
+    writeJson(file, benchmark, results);
+    return 0;
+}
+
+} // namespace bench
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_BENCH_COMMON_HPP
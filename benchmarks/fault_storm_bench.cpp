@@ -0,0 +1,815 @@
+// Fault-storm throughput benchmark.
+//
+// Every worker thread faults in a loop inside guarded blocks and the benchmark
+// reports how many faults per second the library recovers from, per thread
+// count from 1 to the number of cores, together with the scaling efficiency
+// (per-thread rate divided by the single-thread rate).
+//
+// Fault kinds:
+//   - null:          store through a null pointer
+//   - wild:          store through 0xDEADBEEF
+//   - unmapped_page: store to a page that was mapped and then unmapped
+//   - sigbus:        store beyond the end of a truncated file mapping
+//   - sigfpe:        integer division by zero
+// The guard catches SIGSEGV, SIGBUS and SIGFPE (see StormGuard); a kind is
+// skipped when the library handler is not installed for its signal.
+//
+// The single-thread cost of one recovery is broken down into:
+//   - signal_delivery: kernel delivery plus jump back with a bare handler
+//   - cpp_throw:       throwing and catching InvalidMemoryAccessException
+//   - handler:         the rest (library handler, bookkeeping, message)
+//
+// The inject group drives a fault point at several probabilities with both
+// delivery modes of fault_injection.hpp (a real SIGSEGV through the handler,
+// or a simulated fault that resumes the guard directly) on 1 and all cores.
+//
+// The tracking group measures a WriteTrackedRegion: the cost of the first
+// write to a protected page (fault, unprotect, resume), and a checkpoint of a
+// region with 1% of its pages dirty next to copying the whole region, and
+// RollbackRegion transactions writing 4 pages that commit or fault.
+//
+// The prefetch group walks the pages of a file mapping in a fixed random
+// order: the first touch of each page under an AccessRecorder, then cold
+// walks (the file dropped from the page cache with posix_fadvise) without
+// and with a TraceReplay of the recorded order running in the background.
+// A startup does other work before it walks its indexes; the cold walks
+// start after head_start_ms, which the replay already runs during.
+//
+// The compressed group fills a CompressedRegion with a lookup table of short
+// runs and measures compactAll() per page (every page written again before
+// each repeat, so every page is compressed), then the first read of each
+// compressed page (fault, decompression, resume); compressed_ratio is the
+// memory kept by the compressed pages over the size of the region.
+//
+// The jitter group times every single null-pointer recovery and reports the
+// latency percentiles (p50, p99, p99.9; max_ns is the worst one), first in the default mode and
+// then after enableLowJitterMode(); it runs last because the mode cannot be
+// turned off.
+
+#include <algorithm>
+#include <atomic>
+#include <csetjmp>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include "bench_common.hpp"
+#include "try_catch_guard.hpp"
+#include "fault_injection.hpp"
+#include "write_tracking.hpp"
+#include "prefetch.hpp"
+#include "compressed_memory.hpp"
+
+using namespace try_catch_guard::bench;
+
+namespace {
+
+enum class FaultKind { Null, Wild, UnmappedPage, Bus, Fpe };
+
+struct FaultKindInfo {
+    FaultKind kind;
+    const char* name;
+    int signal;
+};
+
+const FaultKindInfo faultKinds[] = {
+    { FaultKind::Null, "null", SIGSEGV },
+    { FaultKind::Wild, "wild", SIGSEGV },
+    { FaultKind::UnmappedPage, "unmapped_page", SIGSEGV },
+    { FaultKind::Bus, "sigbus", SIGBUS },
+    { FaultKind::Fpe, "sigfpe", SIGFPE },
+};
+
+// Per-thread addresses used to produce each kind of fault
+struct FaultTargets {
+    volatile int* unmapped_page = nullptr;
+    volatile int* truncated_file_page = nullptr;
+    void* file_mapping = nullptr;
+    std::size_t page_size = 0;
+
+    FaultTargets()
+    {
+        page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+        // Accessing a shared file mapping past the end of the file raises SIGBUS
+        FILE* file = std::tmpfile();
+        if (file)
+        {
+            int fd = fileno(file);
+            if (ftruncate(fd, static_cast<off_t>(page_size)) == 0)
+            {
+                file_mapping = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (file_mapping != MAP_FAILED && ftruncate(fd, 0) == 0) {
+                    truncated_file_page = static_cast<volatile int*>(file_mapping);
+                }
+            }
+            std::fclose(file);
+        }
+
+        // Unmapped last so that the mappings above cannot reuse the hole
+        void* page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (page != MAP_FAILED)
+        {
+            munmap(page, page_size);
+            unmapped_page = static_cast<volatile int*>(page);
+        }
+    }
+
+    ~FaultTargets()
+    {
+        if (file_mapping && file_mapping != MAP_FAILED) {
+            munmap(file_mapping, page_size);
+        }
+    }
+};
+
+volatile int divisor = 0;
+volatile int sink = 0;
+
+// Raises one fault of the requested kind
+__attribute__((noinline)) void triggerFault(FaultKind kind, const FaultTargets& targets)
+{
+    switch (kind)
+    {
+    case FaultKind::Null:
+        *static_cast<volatile int*>(nullptr) = 1;
+        break;
+    case FaultKind::Wild:
+        *reinterpret_cast<volatile int*>(0xDEADBEEF) = 1;
+        break;
+    case FaultKind::UnmappedPage:
+        *targets.unmapped_page = 1;
+        break;
+    case FaultKind::Bus:
+        *targets.truncated_file_page = 1;
+        break;
+    case FaultKind::Fpe:
+        sink = sink / divisor;
+        break;
+    }
+}
+
+// Guard of the fault loop: _try with the handler installed for every fault kind
+using StormGuard = try_catch_guard::basic_guard<try_catch_guard::policy::catch_signals<SIGSEGV, SIGBUS, SIGFPE>>;
+
+// True when the library has installed its handler for `signal`
+bool isSignalSupported(int signal)
+{
+    try_catch_guard::installGlobalHandlerOnce();
+    StormGuard::signal_policy::install();
+
+    struct sigaction current;
+    if (sigaction(signal, nullptr, &current) != 0) {
+        return false;
+    }
+    return (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == try_catch_guard::threadSegvHandler;
+}
+
+bool isKindAvailable(const FaultKindInfo& info, const FaultTargets& targets)
+{
+    if (!isSignalSupported(info.signal)) {
+        return false;
+    }
+    if (info.kind == FaultKind::UnmappedPage) {
+        return targets.unmapped_page != nullptr;
+    }
+    if (info.kind == FaultKind::Bus) {
+        return targets.truncated_file_page != nullptr;
+    }
+    return true;
+}
+
+// Executes `count` guarded faults and returns the number of recoveries
+std::uint64_t faultLoop(FaultKind kind, const FaultTargets& targets, std::uint64_t count)
+{
+    std::uint64_t recovered = 0;
+
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        try {
+            StormGuard::run([&] { triggerFault(kind, targets); });
+        }
+        catch (const try_catch_guard::InvalidMemoryAccessException&) {
+            ++recovered;
+        }
+    }
+
+    return recovered;
+}
+
+struct StormResult {
+    double seconds = 0.0;
+    std::uint64_t recoveries = 0;
+};
+
+// Runs faultLoop on `threads` threads at the same time
+StormResult runStorm(FaultKind kind, unsigned threads, std::uint64_t faults_per_thread)
+{
+    std::atomic<unsigned> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<std::uint64_t> recoveries(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&] {
+            restoreThreadAffinity();
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            FaultTargets targets;
+            recoveries += faultLoop(kind, targets, faults_per_thread);
+            try_catch_guard::unregisterThreadHandler();
+        });
+    }
+
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+
+    std::uint64_t start = nowNs();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    StormResult result;
+    result.seconds = static_cast<double>(nowNs() - start) / 1e9;
+    result.recoveries = recoveries.load();
+    return result;
+}
+
+thread_local sigjmp_buf rawJumpBuffer;
+
+void rawFaultHandler(int, siginfo_t*, void*)
+{
+    siglongjmp(rawJumpBuffer, 1);
+}
+
+// Cost of kernel signal delivery and jumping back, without the library
+double measureRawDelivery(FaultKind kind, int signal, const FaultTargets& targets, std::uint64_t count)
+{
+    struct sigaction raw;
+    struct sigaction previous;
+    std::memset(&raw, 0, sizeof(raw));
+    raw.sa_sigaction = rawFaultHandler;
+    raw.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&raw.sa_mask);
+    sigaction(signal, &raw, &previous);
+
+    std::uint64_t start = nowNs();
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        if (sigsetjmp(rawJumpBuffer, 0) == 0) {
+            triggerFault(kind, targets);
+        }
+    }
+    std::uint64_t elapsed = nowNs() - start;
+
+    sigaction(signal, &previous, nullptr);
+    return static_cast<double>(elapsed) / static_cast<double>(count);
+}
+
+std::vector<unsigned> threadCounts(unsigned max_threads)
+{
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n < max_threads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+void benchBreakdown(const BenchOptions& options, const FaultKindInfo& info, const FaultTargets& targets,
+                    std::uint64_t count, std::vector<BenchResult>& results)
+{
+    std::string prefix = std::string(info.name) + "_";
+
+    BenchResult total = measure("breakdown", prefix + "total", count, options.repeats, [&] {
+        faultLoop(info.kind, targets, 1);
+    });
+
+    std::vector<double> delivery_samples;
+    for (std::uint64_t r = 0; r < options.repeats; ++r) {
+        delivery_samples.push_back(measureRawDelivery(info.kind, info.signal, targets, count));
+    }
+    BenchResult delivery = summarize("breakdown", prefix + "signal_delivery", delivery_samples, count);
+
+    BenchResult throw_cost = measure("breakdown", prefix + "cpp_throw", count, options.repeats, [] {
+        try {
+            throw try_catch_guard::InvalidMemoryAccessException("Invalid null pointer access exception");
+        }
+        catch (const try_catch_guard::InvalidMemoryAccessException& e) {
+            doNotOptimize(e);
+        }
+    });
+
+    BenchResult entry = measure("breakdown", prefix + "guard_entry", count, options.repeats, [] {
+        _try { sink = sink + 1; }
+        _catch(try_catch_guard::InvalidMemoryAccessException, e) { doNotOptimize(e); }
+    });
+
+    BenchResult handler;
+    handler.group = "breakdown";
+    handler.name = prefix + "handler";
+    handler.iterations = count;
+    handler.repeats = options.repeats;
+    handler.median_ns = std::max(0.0, total.median_ns - delivery.median_ns - throw_cost.median_ns - entry.median_ns);
+    handler.min_ns = std::max(0.0, total.min_ns - delivery.min_ns - throw_cost.min_ns - entry.min_ns);
+    handler.max_ns = std::max(0.0, total.max_ns - delivery.max_ns - throw_cost.max_ns - entry.max_ns);
+
+    results.push_back(total);
+    results.push_back(entry);
+    results.push_back(delivery);
+    results.push_back(throw_cost);
+    results.push_back(handler);
+}
+
+void benchScaling(const BenchOptions& options, const FaultKindInfo& info, std::uint64_t count,
+                  unsigned max_threads, std::vector<BenchResult>& results)
+{
+    double single_thread_rate = 0.0;
+
+    for (unsigned threads : threadCounts(max_threads))
+    {
+        std::vector<double> samples;
+        double best_rate = 0.0;
+
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            StormResult storm = runStorm(info.kind, threads, count);
+            double rate = static_cast<double>(storm.recoveries) / storm.seconds;
+            best_rate = std::max(best_rate, rate);
+            // Wall time per recovery as seen by one thread
+            samples.push_back(storm.seconds * 1e9 * threads / static_cast<double>(storm.recoveries));
+        }
+
+        if (threads == 1) {
+            single_thread_rate = best_rate;
+        }
+
+        BenchResult r = summarize("storm", std::string(info.name) + "_threads_" + std::to_string(threads), samples, count);
+        double per_core = best_rate / threads;
+        r.extra.emplace_back("threads", threads);
+        r.extra.emplace_back("recoveries_per_sec", best_rate);
+        r.extra.emplace_back("recoveries_per_sec_per_core", per_core);
+        r.extra.emplace_back("scaling_efficiency", single_thread_rate > 0.0 ? per_core / single_thread_rate : 0.0);
+        results.push_back(r);
+    }
+}
+
+const double injectionRates[] = { 0.01, 0.1, 1.0 };
+
+// Runs `count` guards around a fault point on `threads` threads; returns the recoveries
+StormResult runInjection(unsigned threads, std::uint64_t count)
+{
+    using InjectGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+    std::atomic<std::uint64_t> recoveries(0);
+    std::vector<std::thread> workers;
+
+    std::uint64_t start = nowNs();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            restoreThreadAffinity();
+            try_catch_guard::injection::setThreadStream(t);
+            std::uint64_t recovered = 0;
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                try_catch_guard::GuardResult result = InjectGuard::run([] {
+                    TRY_CATCH_GUARD_FAULT_POINT("bench.inject");
+                    sink = sink + 1;
+                });
+                recovered += result.faulted() ? 1 : 0;
+            }
+            recoveries += recovered;
+            try_catch_guard::unregisterThreadHandler();
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    StormResult result;
+    result.seconds = static_cast<double>(nowNs() - start) / 1e9;
+    result.recoveries = recoveries.load();
+    return result;
+}
+
+void benchInjection(const BenchOptions& options, std::uint64_t count, unsigned max_threads,
+                    std::vector<BenchResult>& results)
+{
+    namespace injection = try_catch_guard::injection;
+    const std::pair<injection::Delivery, const char*> deliveries[] = {
+        { injection::Delivery::Signal, "signal" },
+        { injection::Delivery::Simulated, "simulated" },
+    };
+
+    for (const auto& delivery : deliveries)
+    {
+        for (double rate : injectionRates)
+        {
+            for (unsigned threads : threadCounts(max_threads))
+            {
+                if (threads != 1 && threads != max_threads) {
+                    continue;
+                }
+
+                char name[64];
+                std::snprintf(name, sizeof(name), "%s_rate_%g_threads_%u", delivery.second, rate, threads);
+                if (!isSelected(options, std::string("inject/") + name)) {
+                    continue;
+                }
+
+                injection::setSiteProbability("bench.inject", rate);
+                std::vector<double> samples;
+                double best_rate = 0.0;
+                double injected_rate = 0.0;
+                for (std::uint64_t r = 0; r < options.repeats; ++r)
+                {
+                    injection::enable(r + 1, delivery.first);
+                    StormResult storm = runInjection(threads, count);
+                    injection::disable();
+                    double guards = static_cast<double>(count) * threads;
+                    samples.push_back(storm.seconds * 1e9 * threads / guards);
+                    best_rate = std::max(best_rate, static_cast<double>(storm.recoveries) / storm.seconds);
+                    injected_rate = static_cast<double>(storm.recoveries) / guards;
+                }
+
+                BenchResult result = summarize("inject", name, samples, count);
+                result.extra.emplace_back("threads", threads);
+                result.extra.emplace_back("injected_rate", injected_rate);
+                result.extra.emplace_back("recoveries_per_sec", best_rate);
+                results.push_back(result);
+            }
+        }
+    }
+}
+
+// Latency of each single recovery, in nanoseconds
+std::vector<double> recoveryLatencies(const FaultTargets& targets, std::uint64_t count)
+{
+    std::vector<double> latencies;
+    latencies.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::uint64_t start = nowNs();
+        _try { triggerFault(FaultKind::Null, targets); }
+        _catch(try_catch_guard::InvalidMemoryAccessException, e) { doNotOptimize(e); }
+        latencies.push_back(static_cast<double>(nowNs() - start));
+    }
+    return latencies;
+}
+
+void benchTracking(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const std::size_t pages = options.quick ? 256 : 4096;
+    const std::uint64_t checkpoints = options.quick ? 20 : 100;
+    try_catch_guard::WriteTrackedRegion region(pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+    const std::size_t page_size = region.pageSize();
+    char* data = static_cast<char*>(region.data());
+    std::vector<char> snapshot(region.size());
+    region.checkpoint(snapshot.data());
+
+    if (isSelected(options, "tracking/first_write"))
+    {
+        // Every repeat writes each page once, after a checkpoint protected them all
+        std::vector<double> samples;
+        for (std::uint64_t r = 0; r < options.repeats + 1; ++r)
+        {
+            region.checkpoint(snapshot.data());
+            std::uint64_t start = nowNs();
+            for (std::size_t page = 0; page < pages; ++page) {
+                data[page * page_size] = static_cast<char>(r);
+            }
+            std::uint64_t elapsed = nowNs() - start;
+            if (r > 0) { // The first repeat is a warm-up
+                samples.push_back(static_cast<double>(elapsed) / static_cast<double>(pages));
+            }
+        }
+        BenchResult result = summarize("tracking", "first_write", samples, pages);
+        result.extra.emplace_back("pages", static_cast<double>(pages));
+        results.push_back(result);
+    }
+
+    if (isSelected(options, "tracking/checkpoint_1pct"))
+    {
+        // One dirty page in every hundred, so every page is its own run
+        region.checkpoint(snapshot.data());
+        std::uint64_t protect_calls = region.stats().protect_calls;
+        std::vector<double> samples;
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            std::uint64_t elapsed = 0;
+            for (std::uint64_t i = 0; i < checkpoints; ++i)
+            {
+                for (std::size_t page = 0; page < pages; page += 100) {
+                    data[page * page_size] = static_cast<char>(i);
+                }
+                std::uint64_t start = nowNs();
+                region.checkpoint(snapshot.data());
+                elapsed += nowNs() - start;
+            }
+            samples.push_back(static_cast<double>(elapsed) / static_cast<double>(checkpoints));
+        }
+        std::uint64_t calls = region.stats().protect_calls - protect_calls;
+        BenchResult result = summarize("tracking", "checkpoint_1pct", samples, checkpoints);
+        result.extra.emplace_back("dirty_pages", static_cast<double>((pages + 99) / 100));
+        result.extra.emplace_back("protect_calls", static_cast<double>(calls) / static_cast<double>(checkpoints * options.repeats));
+        results.push_back(result);
+    }
+
+    if (isSelected(options, "tracking/full_copy"))
+    {
+        results.push_back(measure("tracking", "full_copy", checkpoints, options.repeats, [&] {
+            memcpy(snapshot.data(), data, region.size());
+            clobberMemory();
+        }));
+    }
+
+    const char* outcomes[] = { "commit", "fault" };
+    for (const char* outcome : outcomes)
+    {
+        std::string name = std::string("rollback_4_pages_") + outcome;
+        if (!isSelected(options, "tracking/" + name)) {
+            continue;
+        }
+
+        bool fault = std::string(outcome) == "fault";
+        try_catch_guard::RollbackRegion table(pages * page_size);
+        char* rows = static_cast<char*>(table.data());
+        results.push_back(measure("tracking", name, checkpoints, options.repeats, [&] {
+            try {
+                table.transaction([&] {
+                    for (std::size_t page = 0; page < 4; ++page) {
+                        rows[page * 97 * page_size] += 1;
+                    }
+                    if (fault) {
+                        *static_cast<volatile int*>(nullptr) = 0;
+                    }
+                });
+            }
+            catch (const try_catch_guard::InvalidMemoryAccessException& e) {
+                doNotOptimize(e);
+            }
+        }));
+    }
+}
+
+// Reads one byte of every page in `order`; returns nanoseconds per page
+double walkPages(const char* base, std::size_t page_size, const std::vector<std::uint32_t>& order)
+{
+    std::uint64_t start = nowNs();
+    unsigned sum = 0;
+    for (std::uint32_t page : order) {
+        sum += static_cast<unsigned char>(*static_cast<volatile const char*>(base + page * page_size));
+    }
+    doNotOptimize(sum);
+    return static_cast<double>(nowNs() - start) / static_cast<double>(order.size());
+}
+
+void benchPrefetch(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    bool want_record = isSelected(options, "prefetch/record_first_touch");
+    bool want_cold = isSelected(options, "prefetch/cold_walk");
+    bool want_replay = isSelected(options, "prefetch/cold_walk_replay");
+    if (!want_record && !want_cold && !want_replay) {
+        return;
+    }
+
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t pages = options.quick ? 2048 : 16384;
+    const std::size_t size = pages * page_size;
+    const unsigned head_start_ms = options.quick ? 10 : 50;
+
+    // The file lives in the working directory: /tmp may be a tmpfs, which
+    // has no cold state
+    char file_path[] = "tcg_prefetch_benchXXXXXX";
+    int fd = mkstemp(file_path);
+    if (fd < 0) {
+        std::cerr << "  skipping prefetch: cannot create a file in the working directory" << std::endl;
+        return;
+    }
+    unlink(file_path);
+    std::vector<char> chunk(page_size, 1);
+    for (std::size_t page = 0; page < pages; ++page) {
+        if (write(fd, chunk.data(), page_size) != static_cast<ssize_t>(page_size)) {
+            close(fd);
+            return;
+        }
+    }
+    fsync(fd);
+
+    std::vector<std::uint32_t> order(pages);
+    for (std::size_t page = 0; page < pages; ++page) {
+        order[page] = static_cast<std::uint32_t>(page);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    char trace_path[] = "tcg_prefetch_traceXXXXXX";
+    int trace_fd = mkstemp(trace_path);
+    close(trace_fd);
+
+    // Recording: every first touch is a resumed fault. The replay needs the
+    // trace, so it is recorded for it too.
+    if (want_record || want_replay)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        walkPages(static_cast<char*>(mapping), page_size, order); // Cached, so only the fault is timed
+        munmap(mapping, size);
+
+        std::vector<double> samples;
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            try_catch_guard::prefetch::AccessRecorder recorder(mapping, size);
+            samples.push_back(walkPages(static_cast<char*>(mapping), page_size, order));
+            recorder.writeTrace(trace_path);
+            munmap(mapping, size);
+        }
+        if (want_record) {
+            results.push_back(summarize("prefetch", "record_first_touch", samples, pages));
+        }
+    }
+
+    const char* modes[] = { "cold_walk", "cold_walk_replay" };
+    for (const char* mode : modes)
+    {
+        bool replay = std::string(mode) == "cold_walk_replay";
+        if (!(replay ? want_replay : want_cold)) {
+            continue;
+        }
+
+        std::vector<double> samples;
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            posix_fadvise(fd, 0, static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            try_catch_guard::prefetch::ReplayOptions replay_options;
+            replay_options.fd = fd;
+            try_catch_guard::prefetch::TraceReplay prefetcher(trace_path, mapping, size, replay_options);
+            if (replay) {
+                prefetcher.start();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(head_start_ms));
+            samples.push_back(walkPages(static_cast<char*>(mapping), page_size, order));
+            prefetcher.wait();
+            munmap(mapping, size);
+        }
+        BenchResult result = summarize("prefetch", mode, samples, pages);
+        result.extra.emplace_back("pages", static_cast<double>(pages));
+        result.extra.emplace_back("head_start_ms", head_start_ms);
+        results.push_back(result);
+    }
+
+    unlink(trace_path);
+    close(fd);
+}
+
+void benchCompression(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    bool want_compact = isSelected(options, "compressed/compact_all");
+    bool want_access = isSelected(options, "compressed/first_access");
+    if (!want_compact && !want_access) {
+        return;
+    }
+
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t pages = options.quick ? 1024 : 16384;
+    try_catch_guard::CompressedRegion region(pages * page_size);
+    std::uint32_t* table = static_cast<std::uint32_t*>(region.data());
+    const std::size_t count = region.size() / sizeof(std::uint32_t);
+
+    std::vector<double> compact_samples;
+    std::vector<double> access_samples;
+    for (std::uint64_t r = 0; r < options.repeats + 1; ++r)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            table[i] = static_cast<std::uint32_t>(i / 16 + r);
+        }
+        std::uint64_t start = nowNs();
+        region.compactAll();
+        std::uint64_t compact = nowNs() - start;
+
+        const volatile std::uint32_t* values = table;
+        std::uint64_t sum = 0;
+        start = nowNs();
+        for (std::size_t page = 0; page < pages; ++page) {
+            sum += values[page * page_size / sizeof(std::uint32_t)];
+        }
+        std::uint64_t access = nowNs() - start;
+        doNotOptimize(sum);
+        if (r > 0) { // The first repeat is a warm-up
+            compact_samples.push_back(static_cast<double>(compact) / static_cast<double>(pages));
+            access_samples.push_back(static_cast<double>(access) / static_cast<double>(pages));
+        }
+    }
+
+    region.compactAll();
+    try_catch_guard::compression::CompressedRegionStats stats = region.stats();
+    double ratio = static_cast<double>(stats.compressed_bytes) / static_cast<double>(region.size());
+
+    if (want_compact)
+    {
+        BenchResult result = summarize("compressed", "compact_all", compact_samples, pages);
+        result.extra.emplace_back("pages", static_cast<double>(pages));
+        results.push_back(result);
+    }
+    if (want_access)
+    {
+        BenchResult result = summarize("compressed", "first_access", access_samples, pages);
+        result.extra.emplace_back("compressed_ratio", ratio);
+        results.push_back(result);
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double fraction)
+{
+    std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+void benchJitter(const BenchOptions& options, const FaultTargets& targets, std::uint64_t count,
+                 std::vector<BenchResult>& results)
+{
+    const char* modes[] = { "default", "low_jitter" };
+    for (const char* mode : modes)
+    {
+        std::string name = std::string("null_") + mode;
+        if (!isSelected(options, "jitter/" + name)) {
+            continue;
+        }
+
+        bool locked = true;
+        if (std::string(mode) == "low_jitter") {
+            locked = try_catch_guard::enableLowJitterMode();
+        }
+
+        std::vector<double> latencies;
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            std::vector<double> repeat = recoveryLatencies(targets, count);
+            latencies.insert(latencies.end(), repeat.begin(), repeat.end());
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        BenchResult result = summarize("jitter", name, latencies, count);
+        result.repeats = options.repeats;
+        result.extra.emplace_back("p50_ns", percentile(latencies, 0.5));
+        result.extra.emplace_back("p99_ns", percentile(latencies, 0.99));
+        result.extra.emplace_back("p999_ns", percentile(latencies, 0.999));
+        result.extra.emplace_back("memory_locked", locked ? 1.0 : 0.0);
+        results.push_back(result);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::uint64_t count = options.iterations ? options.iterations : (options.quick ? 2000 : 100000);
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<BenchResult> results;
+
+    FaultTargets targets;
+    for (const FaultKindInfo& info : faultKinds)
+    {
+        bool want_breakdown = isSelected(options, "breakdown/" + std::string(info.name) + "_total");
+        bool want_scaling = isSelected(options, "storm/" + std::string(info.name) + "_threads");
+        if (!want_breakdown && !want_scaling) {
+            continue;
+        }
+        if (!isKindAvailable(info, targets))
+        {
+            std::cerr << "  skipping " << info.name << ": signal not handled by the library" << std::endl;
+            continue;
+        }
+
+        if (want_breakdown) {
+            benchBreakdown(options, info, targets, count, results);
+        }
+        if (want_scaling) {
+            benchScaling(options, info, count, max_threads, results);
+        }
+    }
+
+    benchInjection(options, count, max_threads, results);
+    benchTracking(options, results);
+    benchPrefetch(options, results);
+    benchCompression(options, results);
+    benchJitter(options, targets, count, results);
+
+    try_catch_guard::unregisterThreadHandler();
+
+    return emitResults(options, "fault_storm_bench", results);
+}
@@ -0,0 +1,307 @@
+// End-to-end benchmark: parsing a synthetic binary-record corpus with
+// injected corruption (see record_parser.hpp), three ways:
+//   - checked:          explicit bounds checks on every offset
+//   - guard_per_record: unchecked parse with one _try per record
+//   - guard_batched:    unchecked parse with one _try per batch of records;
+//                       a faulting batch is re-parsed with one _try per record
+//   - speculate_batched: speculate() per batch, unchecked with a checked
+//                        fallback; the site is pinned to the checked parse
+//                        when too many batches fault
+//   - adaptive_per_record: adaptive() per record, one _try per record while
+//                        faults are rare and bounds checks without a guard
+//                        once the decayed fault rate crosses the threshold
+//
+// For every corruption rate the benchmark reports ns per record,
+// records_per_sec and speedup_vs_checked, giving a throughput curve against
+// corruption rate. All strategies must produce the same totals.
+
+#include <cstdlib>
+#include <vector>
+#include "bench_common.hpp"
+#include "record_parser.hpp"
+#include "try_catch_guard.hpp"
+#include "speculate.hpp"
+
+using namespace try_catch_guard::bench;
+
+namespace {
+
+struct CorpusView {
+    const unsigned char* base;
+    std::uint64_t size;
+    const std::uint64_t* table;
+    std::uint64_t records;
+};
+
+ParseTotals parseChecked(const CorpusView& corpus)
+{
+    ParseTotals totals;
+    for (std::uint64_t i = 0; i < corpus.records; ++i)
+    {
+        if (parseRecordChecked(corpus.base, corpus.size, corpus.table, i, totals.sum)) {
+            ++totals.valid;
+        } else {
+            ++totals.rejected;
+        }
+    }
+    return totals;
+}
+
+void parseOneGuarded(const CorpusView& corpus, std::uint64_t index, ParseTotals& totals)
+{
+    bool valid = false;
+    _try {
+        valid = parseRecordUnchecked(corpus.base, corpus.table, index, totals.sum);
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        valid = false;
+    }
+
+    if (valid) {
+        ++totals.valid;
+    } else {
+        ++totals.rejected;
+    }
+}
+
+ParseTotals parseGuardPerRecord(const CorpusView& corpus)
+{
+    ParseTotals totals;
+    for (std::uint64_t i = 0; i < corpus.records; ++i) {
+        parseOneGuarded(corpus, i, totals);
+    }
+    return totals;
+}
+
+ParseTotals parseGuardBatched(const CorpusView& corpus, std::uint64_t batch_size)
+{
+    ParseTotals totals;
+
+    for (std::uint64_t first = 0; first < corpus.records; first += batch_size)
+    {
+        std::uint64_t last = std::min(corpus.records, first + batch_size);
+        ParseTotals batch;
+        bool faulted = false;
+
+        _try {
+            for (std::uint64_t i = first; i < last; ++i)
+            {
+                if (parseRecordUnchecked(corpus.base, corpus.table, i, batch.sum)) {
+                    ++batch.valid;
+                } else {
+                    ++batch.rejected;
+                }
+            }
+        }
+        _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+            faulted = true;
+        }
+
+        if (faulted)
+        {
+            // Discard the partial batch and isolate the corrupted records
+            batch = ParseTotals();
+            for (std::uint64_t i = first; i < last; ++i) {
+                parseOneGuarded(corpus, i, batch);
+            }
+        }
+
+        totals.sum += batch.sum;
+        totals.valid += batch.valid;
+        totals.rejected += batch.rejected;
+    }
+
+    return totals;
+}
+
+ParseTotals parseRange(const CorpusView& corpus, std::uint64_t first, std::uint64_t last, bool checked)
+{
+    ParseTotals totals;
+    for (std::uint64_t i = first; i < last; ++i)
+    {
+        bool valid = checked ? parseRecordChecked(corpus.base, corpus.size, corpus.table, i, totals.sum)
+                             : parseRecordUnchecked(corpus.base, corpus.table, i, totals.sum);
+        if (valid) {
+            ++totals.valid;
+        } else {
+            ++totals.rejected;
+        }
+    }
+    return totals;
+}
+
+ParseTotals parseSpeculateBatched(const CorpusView& corpus, std::uint64_t batch_size,
+                                  try_catch_guard::speculation::Site& site)
+{
+    ParseTotals totals;
+
+    for (std::uint64_t first = 0; first < corpus.records; first += batch_size)
+    {
+        std::uint64_t last = std::min(corpus.records, first + batch_size);
+        ParseTotals batch = try_catch_guard::speculation::speculate(site,
+            [&] { return parseRange(corpus, first, last, false); },
+            [&] { return parseRange(corpus, first, last, true); });
+
+        totals.sum += batch.sum;
+        totals.valid += batch.valid;
+        totals.rejected += batch.rejected;
+    }
+
+    return totals;
+}
+
+ParseTotals parseAdaptivePerRecord(const CorpusView& corpus, try_catch_guard::speculation::AdaptiveSite& site)
+{
+    ParseTotals totals;
+    for (std::uint64_t i = 0; i < corpus.records; ++i)
+    {
+        bool valid = try_catch_guard::speculation::adaptive(site,
+            [&] { return recordInBounds(corpus.base, corpus.size, corpus.table, i); },
+            [&] { return parseRecordUnchecked(corpus.base, corpus.table, i, totals.sum); },
+            [] { return false; });
+        if (valid) {
+            ++totals.valid;
+        } else {
+            ++totals.rejected;
+        }
+    }
+    return totals;
+}
+
+// Times `parse` over the whole corpus and reports ns per record
+template <typename Parse>
+BenchResult measureParse(const BenchOptions& options, const std::string& name, const CorpusView& corpus,
+                         double rate, ParseTotals& totals, Parse&& parse)
+{
+    totals = parse();
+
+    std::vector<double> samples;
+    for (std::uint64_t r = 0; r < options.repeats; ++r)
+    {
+        std::uint64_t start = nowNs();
+        ParseTotals run = parse();
+        std::uint64_t elapsed = nowNs() - start;
+        doNotOptimize(run);
+        samples.push_back(static_cast<double>(elapsed) / static_cast<double>(corpus.records));
+    }
+
+    BenchResult result = summarize("parse", name, std::move(samples), corpus.records);
+    result.extra.emplace_back("corruption_rate", rate);
+    result.extra.emplace_back("records_per_sec", result.median_ns > 0.0 ? 1e9 / result.median_ns : 0.0);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::uint64_t records = options.iterations ? options.iterations : (options.quick ? 50000 : 1000000);
+    const std::uint64_t batch_size = 64;
+    const double rates[] = { 0.0, 0.0001, 0.001, 0.01, 0.05, 0.1 };
+
+    std::vector<BenchResult> results;
+    bool consistent = true;
+
+    for (double rate : rates)
+    {
+        Corpus corpus;
+        if (!corpus.generate(records, 16, rate, 42))
+        {
+            std::cerr << "Failed to allocate the corpus" << std::endl;
+            return 1;
+        }
+        CorpusView view { corpus.data(), corpus.size(), corpus.table(), corpus.recordCount() };
+        std::string suffix = "_rate_" + std::to_string(rate).substr(0, 6);
+
+        ParseTotals checked_totals;
+        ParseTotals totals;
+        double checked_ns = 0.0;
+
+        std::string checked_name = "checked" + suffix;
+        if (isSelected(options, "parse/" + checked_name))
+        {
+            BenchResult r = measureParse(options, checked_name, view, rate, checked_totals, [&] {
+                return parseChecked(view);
+            });
+            checked_ns = r.median_ns;
+            r.extra.emplace_back("speedup_vs_checked", 1.0);
+            results.push_back(r);
+        }
+        else {
+            checked_totals = parseChecked(view);
+        }
+
+        std::string per_record_name = "guard_per_record" + suffix;
+        if (isSelected(options, "parse/" + per_record_name))
+        {
+            BenchResult r = measureParse(options, per_record_name, view, rate, totals, [&] {
+                return parseGuardPerRecord(view);
+            });
+            r.extra.emplace_back("speedup_vs_checked", checked_ns > 0.0 ? checked_ns / r.median_ns : 0.0);
+            results.push_back(r);
+            consistent = consistent && totals == checked_totals;
+        }
+
+        std::string batched_name = "guard_batched" + suffix;
+        if (isSelected(options, "parse/" + batched_name))
+        {
+            BenchResult r = measureParse(options, batched_name, view, rate, totals, [&] {
+                return parseGuardBatched(view, batch_size);
+            });
+            r.extra.emplace_back("speedup_vs_checked", checked_ns > 0.0 ? checked_ns / r.median_ns : 0.0);
+            r.extra.emplace_back("batch_size", static_cast<double>(batch_size));
+            results.push_back(r);
+            consistent = consistent && totals == checked_totals;
+        }
+
+        std::string speculate_name = "speculate_batched" + suffix;
+        if (isSelected(options, "parse/" + speculate_name))
+        {
+            try_catch_guard::speculation::Site site("parser_bench.batch");
+            BenchResult r = measureParse(options, speculate_name, view, rate, totals, [&] {
+                return parseSpeculateBatched(view, batch_size, site);
+            });
+            r.extra.emplace_back("speedup_vs_checked", checked_ns > 0.0 ? checked_ns / r.median_ns : 0.0);
+            r.extra.emplace_back("batch_size", static_cast<double>(batch_size));
+            r.extra.emplace_back("pinned", site.pinned() ? 1.0 : 0.0);
+            results.push_back(r);
+            consistent = consistent && totals == checked_totals;
+        }
+
+        std::string adaptive_name = "adaptive_per_record" + suffix;
+        if (isSelected(options, "parse/" + adaptive_name))
+        {
+            try_catch_guard::speculation::AdaptiveSite site("parser_bench.record");
+            BenchResult r = measureParse(options, adaptive_name, view, rate, totals, [&] {
+                return parseAdaptivePerRecord(view, site);
+            });
+            r.extra.emplace_back("speedup_vs_checked", checked_ns > 0.0 ? checked_ns / r.median_ns : 0.0);
+            r.extra.emplace_back("validating", site.validating() ? 1.0 : 0.0);
+            r.extra.emplace_back("fault_rate", site.faultRate());
+            results.push_back(r);
+            consistent = consistent && totals == checked_totals;
+        }
+
+        if (checked_totals.rejected != corpus.corrupted())
+        {
+            std::cerr << "Checked parser rejected " << checked_totals.rejected << " records, expected "
+                      << corpus.corrupted() << std::endl;
+            consistent = false;
+        }
+    }
+
+    try_catch_guard::unregisterThreadHandler();
+
+    int status = emitResults(options, "parser_bench", results);
+    if (!consistent)
+    {
+        std::cerr << "Parsers disagree on the corpus totals" << std::endl;
+        return 1;
+    }
+    return status;
+}
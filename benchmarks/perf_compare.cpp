@@ -0,0 +1,409 @@
+// Compares benchmark results against the committed baseline.
+//
+// Usage:
+//   perf_compare --baseline <perf_baseline.json> --results <dir>
+//                [--metric <id>] [--tolerance <percent>] [--update]
+//
+// The baseline lists metrics as { "id", "benchmark", "group", "name", "field",
+// "baseline", "tolerance_percent", "higher_is_better" }. For every selected
+// metric the matching result is read from <dir>/<benchmark>.json (written by
+// the benchmark's --json option). The tool exits with 1 when a metric is more
+// than its tolerance worse than the baseline (higher for timings, lower for
+// rates marked "higher_is_better"), or when a result is missing.
+// --tolerance overrides every per-metric tolerance; --update rewrites the
+// baseline values with the current results, and leaves the file untouched
+// when a result is missing.
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Minimal JSON value, enough for the benchmark and baseline files
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const std::string& key) const
+    {
+        for (const auto& member : members)
+        {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    JsonValue* find(const std::string& key)
+    {
+        return const_cast<JsonValue*>(static_cast<const JsonValue*>(this)->find(key));
+    }
+
+    std::string stringOr(const std::string& key, const std::string& fallback) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == Type::String ? value->text : fallback;
+    }
+
+    double numberOr(const std::string& key, double fallback) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == Type::Number ? value->number : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& input) : input_(input) {}
+
+    bool parse(JsonValue& value)
+    {
+        return parseValue(value) && (skipSpace(), pos_ == input_.size());
+    }
+
+private:
+    const std::string& input_;
+    std::size_t pos_ = 0;
+
+    void skipSpace()
+    {
+        while (pos_ < input_.size() && std::isspace(static_cast<unsigned char>(input_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char expected)
+    {
+        skipSpace();
+        if (pos_ < input_.size() && input_[pos_] == expected)
+        {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string& out)
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        while (pos_ < input_.size() && input_[pos_] != '"')
+        {
+            if (input_[pos_] == '\\' && pos_ + 1 < input_.size()) {
+                ++pos_;
+            }
+            out += input_[pos_++];
+        }
+        return consume('"');
+    }
+
+    bool parseLiteral(const char* literal)
+    {
+        std::string expected(literal);
+        if (input_.compare(pos_, expected.size(), expected) != 0) {
+            return false;
+        }
+        pos_ += expected.size();
+        return true;
+    }
+
+    bool parseValue(JsonValue& value)
+    {
+        skipSpace();
+        if (pos_ >= input_.size()) {
+            return false;
+        }
+
+        char c = input_[pos_];
+        if (c == '{')
+        {
+            value.type = JsonValue::Type::Object;
+            ++pos_;
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                std::pair<std::string, JsonValue> member;
+                if (!parseString(member.first) || !consume(':') || !parseValue(member.second)) {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[')
+        {
+            value.type = JsonValue::Type::Array;
+            ++pos_;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                JsonValue item;
+                if (!parseValue(item)) {
+                    return false;
+                }
+                value.items.push_back(std::move(item));
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"')
+        {
+            value.type = JsonValue::Type::String;
+            return parseString(value.text);
+        }
+        if (c == 't' || c == 'f')
+        {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = c == 't';
+            return parseLiteral(value.boolean ? "true" : "false");
+        }
+        if (c == 'n') {
+            return parseLiteral("null");
+        }
+
+        char* end = nullptr;
+        value.type = JsonValue::Type::Number;
+        value.number = std::strtod(input_.c_str() + pos_, &end);
+        if (end == input_.c_str() + pos_) {
+            return false;
+        }
+        pos_ = static_cast<std::size_t>(end - input_.c_str());
+        return true;
+    }
+};
+
+bool readJsonFile(const std::string& path, JsonValue& value)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+    return JsonParser(content).parse(value);
+}
+
+// Writes `text` as a JSON string, escaping what JsonParser::parseString() unescapes
+void writeJsonString(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+void writeJsonValue(std::ostream& out, const JsonValue& value, int indent)
+{
+    std::string pad(static_cast<std::size_t>(indent), ' ');
+    switch (value.type)
+    {
+    case JsonValue::Type::Null:
+        out << "null";
+        break;
+    case JsonValue::Type::Bool:
+        out << (value.boolean ? "true" : "false");
+        break;
+    case JsonValue::Type::Number:
+        out << value.number;
+        break;
+    case JsonValue::Type::String:
+        writeJsonString(out, value.text);
+        break;
+    case JsonValue::Type::Array:
+        out << "[\n";
+        for (std::size_t i = 0; i < value.items.size(); ++i)
+        {
+            out << pad << "  ";
+            writeJsonValue(out, value.items[i], indent + 2);
+            out << (i + 1 < value.items.size() ? ",\n" : "\n");
+        }
+        out << pad << "]";
+        break;
+    case JsonValue::Type::Object:
+        out << "{\n";
+        for (std::size_t i = 0; i < value.members.size(); ++i)
+        {
+            out << pad << "  ";
+            writeJsonString(out, value.members[i].first);
+            out << ": ";
+            writeJsonValue(out, value.members[i].second, indent + 2);
+            out << (i + 1 < value.members.size() ? ",\n" : "\n");
+        }
+        out << pad << "}";
+        break;
+    }
+}
+
+// Looks up `field` of the result with the given group and name
+bool findResult(const JsonValue& document, const std::string& group, const std::string& name,
+                const std::string& field, double& value)
+{
+    const JsonValue* results = document.find("results");
+    if (!results) {
+        return false;
+    }
+    for (const JsonValue& result : results->items)
+    {
+        if (result.stringOr("group", "") == group && result.stringOr("name", "") == name)
+        {
+            const JsonValue* found = result.find(field);
+            if (found && found->type == JsonValue::Type::Number)
+            {
+                value = found->number;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string baseline_path;
+    std::string results_dir;
+    std::string metric_filter;
+    double tolerance_override = -1.0;
+    bool update = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--baseline" && has_value) {
+            baseline_path = argv[++i];
+        } else if (arg == "--results" && has_value) {
+            results_dir = argv[++i];
+        } else if (arg == "--metric" && has_value) {
+            metric_filter = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance_override = std::atof(argv[++i]);
+        } else if (arg == "--update") {
+            update = true;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " --baseline <file> --results <dir> [--metric <id>] [--tolerance <percent>] [--update]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    JsonValue baseline;
+    if (baseline_path.empty() || !readJsonFile(baseline_path, baseline))
+    {
+        std::cerr << "Failed to read baseline " << baseline_path << std::endl;
+        return 2;
+    }
+
+    JsonValue* metrics = baseline.find("metrics");
+    if (!metrics || metrics->type != JsonValue::Type::Array)
+    {
+        std::cerr << "Baseline has no \"metrics\" array" << std::endl;
+        return 2;
+    }
+
+    double default_tolerance = baseline.numberOr("tolerance_percent", 25.0);
+    std::map<std::string, std::unique_ptr<JsonValue>> documents;
+    int checked = 0;
+    int failures = 0;
+
+    for (JsonValue& metric : metrics->items)
+    {
+        std::string id = metric.stringOr("id", "");
+        if (!metric_filter.empty() && id != metric_filter) {
+            continue;
+        }
+
+        std::string benchmark = metric.stringOr("benchmark", "");
+        std::string group = metric.stringOr("group", "");
+        std::string name = metric.stringOr("name", "");
+        std::string field = metric.stringOr("field", "min_ns");
+        double expected = metric.numberOr("baseline", 0.0);
+        double tolerance = tolerance_override >= 0.0 ? tolerance_override : metric.numberOr("tolerance_percent", default_tolerance);
+        const JsonValue* higher = metric.find("higher_is_better");
+        bool higher_is_better = higher && higher->type == JsonValue::Type::Bool && higher->boolean;
+
+        std::unique_ptr<JsonValue>& document = documents[benchmark];
+        if (!document)
+        {
+            document.reset(new JsonValue());
+            std::string path = results_dir + "/" + benchmark + ".json";
+            if (!readJsonFile(path, *document)) {
+                std::cerr << "Failed to read results " << path << std::endl;
+            }
+        }
+
+        ++checked;
+        double actual = 0.0;
+        if (!findResult(*document, group, name, field, actual))
+        {
+            std::cerr << "FAIL " << id << ": no result " << group << "/" << name << " (" << field << ") in " << benchmark << std::endl;
+            ++failures;
+            continue;
+        }
+
+        if (update)
+        {
+            JsonValue* stored = metric.find("baseline");
+            if (stored) {
+                stored->number = actual;
+            }
+            std::cout << "UPDATE " << id << ": " << expected << " -> " << actual << std::endl;
+            continue;
+        }
+
+        double change_percent = expected > 0.0 ? (actual - expected) / expected * 100.0 : 0.0;
+        bool regressed = higher_is_better ? -change_percent > tolerance : change_percent > tolerance;
+        std::cout << (regressed ? "FAIL " : "OK   ") << id << ": " << actual << " vs baseline " << expected
+                  << " (" << (change_percent >= 0.0 ? "+" : "") << change_percent << "%, tolerance " << tolerance << "%)"
+                  << std::endl;
+        if (regressed) {
+            ++failures;
+        }
+    }
+
+    if (checked == 0)
+    {
+        std::cerr << "No metric matched" << (metric_filter.empty() ? "" : " " + metric_filter) << std::endl;
+        return 2;
+    }
+
+    if (update && failures)
+    {
+        std::cerr << "Baseline not updated: " << failures << " metric(s) failed" << std::endl;
+        return 1;
+    }
+
+    if (update)
+    {
+        std::ofstream out(baseline_path);
+        writeJsonValue(out, baseline, 0);
+        out << "\n";
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+#ifndef TRY_CATCH_GUARD_RECORD_PARSER_HPP
+#define TRY_CATCH_GUARD_RECORD_PARSER_HPP
+
+// Synthetic binary-record corpus and the parsers used by parser_bench.
+//
+// Corpus layout (all offsets are relative to the start of the corpus):
+//
+//   CorpusHeader { record_count, table_offset }
+//   RecordHeader[record_count] { magic, count, values_offset }
+//   uint32_t values[...]            (the values of every record)
+//   uint64_t table[record_count]    (offset of each RecordHeader)
+//
+// The corpus is followed by a PROT_NONE guard region. Corruption makes a
+// record unreadable in one of two ways, both pointing into the guard region:
+//   - bad offset:  the table entry points past the end of the corpus
+//   - truncation:  the values range of the record runs past the end of the corpus
+//
+// parseRecordChecked() validates every offset and never faults;
+// parseRecordUnchecked() trusts the data and faults on corrupted records.
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace try_catch_guard {
+namespace bench {
+
+constexpr std::uint32_t recordMagic = 0x52454331; // "REC1"
+
+struct CorpusHeader {
+    std::uint64_t record_count;
+    std::uint64_t table_offset;
+};
+
+struct RecordHeader {
+    std::uint32_t magic;
+    std::uint32_t count;
+    std::uint64_t values_offset;
+};
+
+// Totals produced by a parse; two parsers agree when their totals are equal
+struct ParseTotals {
+    std::uint64_t sum = 0;
+    std::uint64_t valid = 0;
+    std::uint64_t rejected = 0;
+
+    bool operator==(const ParseTotals& other) const
+    {
+        return sum == other.sum && valid == other.valid && rejected == other.rejected;
+    }
+};
+
+// A corpus in an mmap'd buffer followed by an inaccessible guard region
+class Corpus {
+public:
+    static constexpr std::size_t guardSize = 1 << 20;
+
+    Corpus() = default;
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+
+    ~Corpus()
+    {
+        release();
+    }
+
+    // Builds `record_count` records with 1..max_values values each and
+    // corrupts about `corruption_rate` of them (half bad offsets, half truncations)
+    bool generate(std::uint64_t record_count, std::uint32_t max_values, double corruption_rate, std::uint64_t seed)
+    {
+        release();
+
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<std::uint32_t> value_count(1, max_values);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        std::vector<std::uint32_t> counts(record_count);
+        std::uint64_t total_values = 0;
+        for (auto& count : counts)
+        {
+            count = value_count(rng);
+            total_values += count;
+        }
+
+        std::uint64_t headers_offset = sizeof(CorpusHeader);
+        std::uint64_t values_offset = headers_offset + record_count * sizeof(RecordHeader);
+        std::uint64_t table_offset = values_offset + total_values * sizeof(std::uint32_t);
+        table_offset = (table_offset + 7) & ~std::uint64_t(7);
+        size_ = table_offset + record_count * sizeof(std::uint64_t);
+
+        std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        mapped_size_ = ((size_ + page - 1) / page) * page + guardSize;
+        void* memory = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            memory_ = nullptr;
+            return false;
+        }
+        memory_ = static_cast<unsigned char*>(memory);
+
+        // Everything after the (page-aligned) end of the corpus is inaccessible
+        std::size_t accessible = mapped_size_ - guardSize;
+        mprotect(memory_ + accessible, guardSize, PROT_NONE);
+        guard_offset_ = accessible;
+
+        CorpusHeader header { record_count, table_offset };
+        std::memcpy(memory_, &header, sizeof(header));
+
+        std::uint64_t* table = reinterpret_cast<std::uint64_t*>(memory_ + table_offset);
+        std::uint64_t next_value = values_offset;
+        corrupted_ = 0;
+
+        for (std::uint64_t i = 0; i < record_count; ++i)
+        {
+            std::uint64_t record_offset = headers_offset + i * sizeof(RecordHeader);
+            RecordHeader* record = reinterpret_cast<RecordHeader*>(memory_ + record_offset);
+            record->magic = recordMagic;
+            record->count = counts[i];
+            record->values_offset = next_value;
+
+            std::uint32_t* values = reinterpret_cast<std::uint32_t*>(memory_ + next_value);
+            for (std::uint32_t v = 0; v < counts[i]; ++v) {
+                values[v] = static_cast<std::uint32_t>(rng());
+            }
+            next_value += counts[i] * sizeof(std::uint32_t);
+            table[i] = record_offset;
+
+            if (unit(rng) < corruption_rate)
+            {
+                ++corrupted_;
+                if (rng() & 1) {
+                    table[i] = guard_offset_ + (rng() % (guardSize / 2));
+                } else {
+                    record->values_offset = size_ - sizeof(std::uint32_t);
+                    record->count = static_cast<std::uint32_t>(guardSize);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    const unsigned char* data() const { return memory_; }
+    std::uint64_t size() const { return size_; }
+    std::uint64_t corrupted() const { return corrupted_; }
+
+    std::uint64_t recordCount() const
+    {
+        return reinterpret_cast<const CorpusHeader*>(memory_)->record_count;
+    }
+
+    const std::uint64_t* table() const
+    {
+        return reinterpret_cast<const std::uint64_t*>(memory_ + reinterpret_cast<const CorpusHeader*>(memory_)->table_offset);
+    }
+
+private:
+    unsigned char* memory_ = nullptr;
+    std::size_t mapped_size_ = 0;
+    std::uint64_t size_ = 0;
+    std::uint64_t guard_offset_ = 0;
+    std::uint64_t corrupted_ = 0;
+
+    void release()
+    {
+        if (memory_) {
+            munmap(memory_, mapped_size_);
+        }
+        memory_ = nullptr;
+        mapped_size_ = 0;
+        size_ = 0;
+    }
+};
+
+// Parses record `index` with explicit bounds checks; returns false for a corrupted record
+inline bool parseRecordChecked(const unsigned char* base, std::uint64_t size, const std::uint64_t* table,
+                               std::uint64_t index, std::uint64_t& sum)
+{
+    std::uint64_t offset = table[index];
+    if (offset > size || size - offset < sizeof(RecordHeader)) {
+        return false;
+    }
+
+    const RecordHeader* record = reinterpret_cast<const RecordHeader*>(base + offset);
+    if (record->magic != recordMagic) {
+        return false;
+    }
+
+    std::uint64_t bytes = static_cast<std::uint64_t>(record->count) * sizeof(std::uint32_t);
+    if (record->values_offset > size || size - record->values_offset < bytes) {
+        return false;
+    }
+
+    const std::uint32_t* values = reinterpret_cast<const std::uint32_t*>(base + record->values_offset);
+    std::uint64_t local = 0;
+    for (std::uint32_t v = 0; v < record->count; ++v) {
+        local += values[v];
+    }
+    sum += local;
+    return true;
+}
+
+// Checks the offsets of record `index` without reading its values; true when
+// parseRecordUnchecked() cannot fault on it
+inline bool recordInBounds(const unsigned char* base, std::uint64_t size, const std::uint64_t* table,
+                           std::uint64_t index)
+{
+    std::uint64_t offset = table[index];
+    if (offset > size || size - offset < sizeof(RecordHeader)) {
+        return false;
+    }
+
+    const RecordHeader* record = reinterpret_cast<const RecordHeader*>(base + offset);
+    std::uint64_t bytes = static_cast<std::uint64_t>(record->count) * sizeof(std::uint32_t);
+    return record->magic != recordMagic || (record->values_offset <= size && size - record->values_offset >= bytes);
+}
+
+// Parses record `index` trusting every offset; faults on a corrupted record
+inline bool parseRecordUnchecked(const unsigned char* base, const std::uint64_t* table,
+                                 std::uint64_t index, std::uint64_t& sum)
+{
+    const RecordHeader* record = reinterpret_cast<const RecordHeader*>(base + table[index]);
+    if (record->magic != recordMagic) {
+        return false;
+    }
+
+    const std::uint32_t* values = reinterpret_cast<const std::uint32_t*>(base + record->values_offset);
+    std::uint64_t local = 0;
+    for (std::uint32_t v = 0; v < record->count; ++v) {
+        local += values[v];
+    }
+    sum += local;
+    return true;
+}
+
+} // namespace bench
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_RECORD_PARSER_HPP
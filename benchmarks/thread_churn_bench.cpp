@@ -0,0 +1,150 @@
+// Thread-churn benchmark for the thread registry.
+//
+// Starts many short-lived threads in concurrent waves; each thread performs
+// one guarded block (which registers the thread) and then optionally calls
+// unregisterThreadHandler(). Reported per mode ("unregister" / "no_unregister"):
+//   - threads_per_sec:        churn throughput
+//   - first guard latency:    median/min/max ns of the first _try in each thread
+//                             (includes registerThreadHandler)
+//   - mutex_busy_ratio:       fraction of try_lock() probes on getHandlersMutex()
+//                             that found the mutex held during the run
+//   - rss_drift_kb:           resident set growth over the run
+//   - registry_entries:       registered threads after the run (threads that
+//                             exit without unregistering are removed at exit)
+//   - per_thread_bytes:       library memory per registered thread
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "bench_common.hpp"
+#include "try_catch_guard.hpp"
+
+using namespace try_catch_guard::bench;
+
+namespace {
+
+volatile int sink = 0;
+
+// Resident set size in KiB, read from /proc/self/statm
+double residentKb()
+{
+    std::ifstream statm("/proc/self/statm");
+    long size_pages = 0;
+    long resident_pages = 0;
+    statm >> size_pages >> resident_pages;
+    return static_cast<double>(resident_pages) * static_cast<double>(sysconf(_SC_PAGESIZE)) / 1024.0;
+}
+
+BenchResult runChurn(const BenchOptions& options, bool unregister, std::uint64_t total_threads, unsigned wave_size)
+{
+    std::vector<double> first_use_samples(total_threads);
+    std::atomic<bool> sampling(true);
+    std::uint64_t probes = 0;
+    std::uint64_t busy_probes = 0;
+
+    // Samples the registry mutex while the churn runs
+    std::thread sampler([&] {
+        while (sampling.load(std::memory_order_relaxed))
+        {
+            std::mutex& mutex = try_catch_guard::getHandlersMutex();
+            if (mutex.try_lock()) {
+                mutex.unlock();
+            } else {
+                ++busy_probes;
+            }
+            ++probes;
+            std::this_thread::yield();
+        }
+    });
+
+    double rss_before = residentKb();
+    std::uint64_t start = nowNs();
+
+    for (std::uint64_t launched = 0; launched < total_threads; )
+    {
+        std::vector<std::thread> wave;
+        for (unsigned w = 0; w < wave_size && launched < total_threads; ++w, ++launched)
+        {
+            double* sample = &first_use_samples[launched];
+            wave.emplace_back([sample, unregister] {
+                restoreThreadAffinity();
+
+                std::uint64_t entry = nowNs();
+                _try {
+                    sink = sink + 1;
+                }
+                _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                    doNotOptimize(e);
+                }
+                *sample = static_cast<double>(nowNs() - entry);
+
+                if (unregister) {
+                    try_catch_guard::unregisterThreadHandler();
+                }
+            });
+        }
+        for (auto& thread : wave) {
+            thread.join();
+        }
+    }
+
+    double seconds = static_cast<double>(nowNs() - start) / 1e9;
+    double rss_after = residentKb();
+
+    sampling.store(false);
+    sampler.join();
+
+    BenchResult result = summarize("churn", unregister ? "unregister" : "no_unregister",
+                                   std::move(first_use_samples), 1);
+    result.repeats = options.repeats;
+    result.extra.emplace_back("threads", static_cast<double>(total_threads));
+    result.extra.emplace_back("wave_size", wave_size);
+    result.extra.emplace_back("threads_per_sec", static_cast<double>(total_threads) / seconds);
+    result.extra.emplace_back("mutex_busy_ratio", probes ? static_cast<double>(busy_probes) / static_cast<double>(probes) : 0.0);
+    result.extra.emplace_back("rss_drift_kb", rss_after - rss_before);
+    try_catch_guard::MemoryFootprint footprint = try_catch_guard::getMemoryFootprint();
+    result.extra.emplace_back("registry_entries", static_cast<double>(footprint.registered_threads));
+    result.extra.emplace_back("per_thread_bytes", static_cast<double>(footprint.per_thread_bytes));
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::uint64_t total_threads = options.iterations ? options.iterations : (options.quick ? 2000 : 20000);
+    unsigned wave_size = std::max(4u, 2 * std::thread::hardware_concurrency());
+    std::vector<BenchResult> results;
+
+    for (bool unregister : { true, false })
+    {
+        std::string name = unregister ? "unregister" : "no_unregister";
+        if (!isSelected(options, "churn/" + name)) {
+            continue;
+        }
+
+        // Keep the repeat with the best throughput; report its latency and drift
+        BenchResult best;
+        double best_rate = -1.0;
+        for (std::uint64_t r = 0; r < options.repeats; ++r)
+        {
+            BenchResult result = runChurn(options, unregister, total_threads, wave_size);
+            double rate = extraValue(result, "threads_per_sec");
+            if (rate > best_rate)
+            {
+                best_rate = rate;
+                best = result;
+            }
+        }
+        results.push_back(best);
+    }
+
+    return emitResults(options, "thread_churn_bench", results);
+}
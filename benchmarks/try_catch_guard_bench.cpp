@@ -0,0 +1,437 @@
+// Microbenchmarks for the cost of entering and leaving a guarded block.
+//
+// Measured paths:
+//   - entry:    empty plain try vs empty _try vs an empty tcg_call() through the
+//               C interface, and an 8-byte safe read; basic_guard with the
+//               result policy alone and with stats and cleanups
+//   - callable: std::function vs template callable invocation, and segvTryBlock
+//               with a pre-built std::function vs a lambda converted per call
+//   - nesting:  _try nested from 1 to 1000 levels (total and per level), and
+//               the cost of entering one more _try at each of those depths
+//   - thread:   first guard use in a fresh thread vs a warm thread
+//   - tx:       16 scattered int stores in a guard, plain and through tx_write()
+//               in an undo-logged guard; write_ns is the cost of one logged write
+//   - context:  every context-capture backend (context_capture.hpp): capture
+//               alone and capture plus resume; the other groups use the backend
+//               the library was built with (TRY_CATCH_GUARD_CONTEXT_BACKEND)
+//
+// The results are written as JSON (see bench_common.hpp).
+
+#include <functional>
+#include <thread>
+#include <vector>
+#include "bench_common.hpp"
+#include "try_catch_guard.h"
+#include "try_catch_guard.hpp"
+
+using namespace try_catch_guard::bench;
+
+namespace {
+
+volatile int sink = 0;
+
+void emptyWork()
+{
+    sink = sink + 1;
+}
+
+void emptyWorkC(void*)
+{
+    emptyWork();
+}
+
+template <typename F>
+__attribute__((noinline)) void invokeTemplate(F&& callable)
+{
+    callable();
+}
+
+__attribute__((noinline)) void invokeFunction(const std::function<void()>& callable)
+{
+    callable();
+}
+
+// Enters `depth` nested _try blocks and executes emptyWork() in the innermost one
+__attribute__((noinline)) void nestedGuards(int depth)
+{
+    if (depth == 0)
+    {
+        emptyWork();
+        return;
+    }
+
+    _try {
+        nestedGuards(depth - 1);
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        doNotOptimize(e);
+    }
+}
+
+// Runs `work` inside `depth` nested _try blocks
+__attribute__((noinline)) void insideNestedGuards(int depth, const std::function<void()>& work)
+{
+    if (depth == 0)
+    {
+        work();
+        return;
+    }
+
+    _try {
+        insideNestedGuards(depth - 1, work);
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        doNotOptimize(e);
+    }
+}
+
+__attribute__((noinline)) void nestedPlainTry(int depth)
+{
+    if (depth == 0)
+    {
+        emptyWork();
+        return;
+    }
+
+    try {
+        nestedPlainTry(depth - 1);
+    }
+    catch (const std::exception& e) {
+        doNotOptimize(e);
+    }
+}
+
+void benchEntry(const BenchOptions& options, std::uint64_t iterations, std::vector<BenchResult>& results)
+{
+    if (isSelected(options, "entry/baseline_call")) {
+        results.push_back(measure("entry", "baseline_call", iterations, options.repeats, [] { emptyWork(); }));
+    }
+
+    if (isSelected(options, "entry/plain_try_empty"))
+    {
+        results.push_back(measure("entry", "plain_try_empty", iterations, options.repeats, [] {
+            try {
+                emptyWork();
+            }
+            catch (const std::exception& e) {
+                doNotOptimize(e);
+            }
+        }));
+    }
+
+    if (isSelected(options, "entry/guard_try_empty"))
+    {
+        results.push_back(measure("entry", "guard_try_empty", iterations, options.repeats, [] {
+            _try {
+                emptyWork();
+            }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                doNotOptimize(e);
+            }
+        }));
+    }
+
+    if (isSelected(options, "entry/basic_guard_result_empty"))
+    {
+        using Guard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+        results.push_back(measure("entry", "basic_guard_result_empty", iterations, options.repeats, [] {
+            try_catch_guard::GuardResult result = Guard::run([] { emptyWork(); });
+            doNotOptimize(result);
+        }));
+    }
+
+    if (isSelected(options, "entry/basic_guard_full_empty"))
+    {
+        using Guard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault,
+                                                   try_catch_guard::policy::thread_stats,
+                                                   try_catch_guard::policy::fault_cleanups>;
+        results.push_back(measure("entry", "basic_guard_full_empty", iterations, options.repeats, [] {
+            try_catch_guard::GuardResult result = Guard::run([] { emptyWork(); });
+            doNotOptimize(result);
+        }));
+    }
+
+    if (isSelected(options, "entry/c_abi_call_empty"))
+    {
+        results.push_back(measure("entry", "c_abi_call_empty", iterations, options.repeats, [] {
+            tcg_fault_info info;
+            int status = tcg_call(emptyWorkC, nullptr, &info);
+            doNotOptimize(status);
+        }));
+    }
+
+    if (isSelected(options, "entry/safe_read_8"))
+    {
+        long source = 1;
+        results.push_back(measure("entry", "safe_read_8", iterations, options.repeats, [&] {
+            long value = 0;
+            int status = tcg_safe_read(&value, &source, sizeof(value));
+            doNotOptimize(value);
+            doNotOptimize(status);
+        }));
+    }
+}
+
+void benchTx(const BenchOptions& options, std::uint64_t iterations, std::vector<BenchResult>& results)
+{
+    static int table[1024];
+    constexpr int writes = 16;
+
+    using PlainGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+    using TxGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault,
+                                                 try_catch_guard::policy::undo_log>;
+
+    BenchResult plain;
+    bool want_plain = isSelected(options, "tx/plain_writes_16");
+    bool want_tx = isSelected(options, "tx/tx_writes_16");
+    if (want_plain || want_tx)
+    {
+        plain = measure("tx", "plain_writes_16", iterations, options.repeats, [] {
+            try_catch_guard::GuardResult result = PlainGuard::run([] {
+                for (int i = 0; i < writes; ++i) {
+                    table[(i * 67) & 1023] = i;
+                }
+                clobberMemory();
+            });
+            doNotOptimize(result);
+        });
+        if (want_plain) {
+            results.push_back(plain);
+        }
+    }
+
+    if (want_tx)
+    {
+        BenchResult r = measure("tx", "tx_writes_16", iterations, options.repeats, [] {
+            try_catch_guard::GuardResult result = TxGuard::run([] {
+                for (int i = 0; i < writes; ++i) {
+                    try_catch_guard::tx_write(&table[(i * 67) & 1023], i);
+                }
+                clobberMemory();
+            });
+            doNotOptimize(result);
+        });
+        r.extra.emplace_back("write_ns", (r.median_ns - plain.median_ns) / writes);
+        results.push_back(r);
+    }
+}
+
+void benchCallable(const BenchOptions& options, std::uint64_t iterations, std::vector<BenchResult>& results)
+{
+    if (isSelected(options, "callable/template_invoke")) {
+        results.push_back(measure("callable", "template_invoke", iterations, options.repeats, [] {
+            invokeTemplate([] { emptyWork(); });
+        }));
+    }
+
+    if (isSelected(options, "callable/std_function_invoke"))
+    {
+        std::function<void()> prebuilt = [] { emptyWork(); };
+        results.push_back(measure("callable", "std_function_invoke", iterations, options.repeats, [&] {
+            invokeFunction(prebuilt);
+        }));
+    }
+
+    if (isSelected(options, "callable/std_function_construct_invoke")) {
+        results.push_back(measure("callable", "std_function_construct_invoke", iterations, options.repeats, [] {
+            int captured = 1;
+            invokeFunction([&] { sink = sink + captured; });
+        }));
+    }
+
+    if (isSelected(options, "callable/segv_try_block_prebuilt"))
+    {
+        std::function<void()> prebuilt = [] { emptyWork(); };
+        results.push_back(measure("callable", "segv_try_block_prebuilt", iterations, options.repeats, [&] {
+            try_catch_guard::segvTryBlock(prebuilt);
+        }));
+    }
+
+    if (isSelected(options, "callable/segv_try_block_lambda")) {
+        results.push_back(measure("callable", "segv_try_block_lambda", iterations, options.repeats, [] {
+            int captured = 1;
+            try_catch_guard::segvTryBlock([&] { sink = sink + captured; });
+        }));
+    }
+}
+
+// Captures `ctx` and returns; the capture macro must run in this frame
+template <typename Context>
+struct ContextOps;
+
+#define TRY_CATCH_GUARD_BENCH_CONTEXT_OPS(Context, CAPTURE)                      \
+    template <>                                                                 \
+    struct ContextOps<try_catch_guard::context::Context> {                      \
+        __attribute__((noinline)) static int capture(try_catch_guard::context::Context& ctx) \
+        {                                                                       \
+            return CAPTURE(ctx);                                                \
+        }                                                                       \
+        __attribute__((noinline)) static int roundTrip(try_catch_guard::context::Context& ctx) \
+        {                                                                       \
+            if (CAPTURE(ctx) == 0) {                                            \
+                resume(ctx);                                                    \
+            }                                                                   \
+            return 1;                                                           \
+        }                                                                       \
+        __attribute__((noinline)) static void resume(try_catch_guard::context::Context& ctx) \
+        {                                                                       \
+            try_catch_guard::context::resumeContext(ctx, 1);                   \
+        }                                                                       \
+    };
+
+TRY_CATCH_GUARD_BENCH_CONTEXT_OPS(SetjmpContext, TRY_CATCH_GUARD_SETJMP_CAPTURE)
+TRY_CATCH_GUARD_BENCH_CONTEXT_OPS(SigsetjmpContext, TRY_CATCH_GUARD_SIGSETJMP_CAPTURE)
+TRY_CATCH_GUARD_BENCH_CONTEXT_OPS(BuiltinContext, TRY_CATCH_GUARD_BUILTIN_CAPTURE)
+#if TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+TRY_CATCH_GUARD_BENCH_CONTEXT_OPS(AsmContext, TRY_CATCH_GUARD_ASM_CAPTURE)
+#endif
+
+template <typename Context>
+void benchBackend(const BenchOptions& options, std::uint64_t iterations, const std::string& backend,
+                  std::vector<BenchResult>& results)
+{
+    Context ctx;
+
+    if (isSelected(options, "context/" + backend + "_capture")) {
+        results.push_back(measure("context", backend + "_capture", iterations, options.repeats, [&] {
+            doNotOptimize(ContextOps<Context>::capture(ctx));
+        }));
+    }
+
+    if (isSelected(options, "context/" + backend + "_capture_resume")) {
+        results.push_back(measure("context", backend + "_capture_resume", iterations, options.repeats, [&] {
+            doNotOptimize(ContextOps<Context>::roundTrip(ctx));
+        }));
+    }
+}
+
+void benchContext(const BenchOptions& options, std::uint64_t iterations, std::vector<BenchResult>& results)
+{
+    benchBackend<try_catch_guard::context::SetjmpContext>(options, iterations, "setjmp", results);
+    benchBackend<try_catch_guard::context::SigsetjmpContext>(options, iterations, "sigsetjmp", results);
+    benchBackend<try_catch_guard::context::BuiltinContext>(options, iterations, "builtin", results);
+#if TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+    benchBackend<try_catch_guard::context::AsmContext>(options, iterations, "asm", results);
+#endif
+}
+
+void benchNesting(const BenchOptions& options, std::uint64_t iterations, std::vector<BenchResult>& results)
+{
+    const int depths[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1000 };
+
+    for (int depth : depths)
+    {
+        std::uint64_t depth_iterations = std::max<std::uint64_t>(1, iterations / depth);
+
+        std::string guard_name = "guard_depth_" + std::to_string(depth);
+        if (isSelected(options, "nesting/" + guard_name))
+        {
+            BenchResult r = measure("nesting", guard_name, depth_iterations, options.repeats, [depth] {
+                nestedGuards(depth);
+            });
+            r.extra.emplace_back("depth", depth);
+            r.extra.emplace_back("median_ns_per_level", r.median_ns / depth);
+            results.push_back(r);
+        }
+
+        std::string plain_name = "plain_try_depth_" + std::to_string(depth);
+        if (isSelected(options, "nesting/" + plain_name))
+        {
+            BenchResult r = measure("nesting", plain_name, depth_iterations, options.repeats, [depth] {
+                nestedPlainTry(depth);
+            });
+            r.extra.emplace_back("depth", depth);
+            r.extra.emplace_back("median_ns_per_level", r.median_ns / depth);
+            results.push_back(r);
+        }
+
+        // One more guard entered on top of depth - 1 live ones: stays flat if
+        // entry cost does not depend on the depth
+        std::string entry_name = "entry_at_depth_" + std::to_string(depth);
+        if (isSelected(options, "nesting/" + entry_name))
+        {
+            insideNestedGuards(depth - 1, [&] {
+                BenchResult r = measure("nesting", entry_name, iterations, options.repeats, [] {
+                    _try { emptyWork(); }
+                    _catch(try_catch_guard::InvalidMemoryAccessException, e) { doNotOptimize(e); }
+                });
+                r.extra.emplace_back("depth", depth);
+                results.push_back(r);
+            });
+        }
+    }
+}
+
+// Times the first and second guard entry of freshly started threads. The first
+// entry includes thread registration (context allocation and registry insert).
+void benchThreadFirstUse(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    bool want_first = isSelected(options, "thread/first_use");
+    bool want_warm = isSelected(options, "thread/warm_use");
+    if (!want_first && !want_warm) {
+        return;
+    }
+
+    std::uint64_t thread_count = options.quick ? 32 : 256;
+    std::vector<double> first_samples;
+    std::vector<double> warm_samples;
+
+    for (std::uint64_t t = 0; t < thread_count; ++t)
+    {
+        double first_ns = 0.0;
+        double warm_ns = 0.0;
+
+        std::thread worker([&] {
+            restoreThreadAffinity();
+
+            std::uint64_t start = nowNs();
+            _try { emptyWork(); }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) { doNotOptimize(e); }
+            first_ns = static_cast<double>(nowNs() - start);
+
+            start = nowNs();
+            _try { emptyWork(); }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) { doNotOptimize(e); }
+            warm_ns = static_cast<double>(nowNs() - start);
+
+            try_catch_guard::unregisterThreadHandler();
+        });
+        worker.join();
+
+        first_samples.push_back(first_ns);
+        warm_samples.push_back(warm_ns);
+    }
+
+    if (want_first) {
+        results.push_back(summarize("thread", "first_use", std::move(first_samples), 1));
+    }
+    if (want_warm) {
+        results.push_back(summarize("thread", "warm_use", std::move(warm_samples), 1));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::uint64_t iterations = options.iterations ? options.iterations : (options.quick ? 20000 : 1000000);
+    std::vector<BenchResult> results;
+
+    benchEntry(options, iterations, results);
+    benchCallable(options, iterations, results);
+    benchTx(options, iterations, results);
+    benchNesting(options, iterations, results);
+    benchThreadFirstUse(options, results);
+    benchContext(options, iterations, results);
+
+    std::cerr << "Library context backend: " << TRY_CATCH_GUARD_BACKEND_NAME << std::endl;
+
+    try_catch_guard::unregisterThreadHandler();
+
+    return emitResults(options, "try_catch_guard_bench", results);
+}
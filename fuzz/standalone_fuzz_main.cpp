@@ -0,0 +1,84 @@
+// Driver for try_catch_guard_fuzz when the compiler has no libFuzzer (e.g. GCC).
+//
+// Usage: try_catch_guard_fuzz [-runs=<n>] [-seed=<n>] [-max_len=<n>] [file ...]
+//
+// Files given on the command line are run once each (to reproduce a crash
+// found by libFuzzer); without files, -runs random inputs of up to -max_len
+// bytes are generated from -seed. The options use libFuzzer's spelling so the
+// same command line works with both builds.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+namespace {
+
+bool parseFlag(const char* arg, const char* name, std::uint64_t& value)
+{
+    std::size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) != 0) {
+        return false;
+    }
+    value = std::strtoull(arg + length, nullptr, 10);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::uint64_t runs = 100000;
+    std::uint64_t seed = 1;
+    std::uint64_t max_len = 4096;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (parseFlag(argv[i], "-runs=", runs) || parseFlag(argv[i], "-seed=", seed) ||
+            parseFlag(argv[i], "-max_len=", max_len)) {
+            continue;
+        }
+        if (argv[i][0] == '-')
+        {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+        files.push_back(argv[i]);
+    }
+
+    if (!files.empty())
+    {
+        for (const std::string& file : files)
+        {
+            std::ifstream input(file, std::ios::binary);
+            if (!input)
+            {
+                std::fprintf(stderr, "Cannot read %s\n", file.c_str());
+                return 2;
+            }
+            std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+        return 0;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::vector<std::uint8_t> data;
+    for (std::uint64_t run = 0; run < runs; ++run)
+    {
+        data.resize(rng() % (max_len + 1));
+        for (auto& byte : data) {
+            byte = static_cast<std::uint8_t>(rng());
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    return 0;
+}
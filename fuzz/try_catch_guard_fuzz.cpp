@@ -0,0 +1,357 @@
+// Fuzz target for the guarded record parser (benchmarks/record_parser.hpp)
+// and the safe-read primitives.
+//
+// Every input is turned into a small record corpus placed at the end of a
+// readable window, with inaccessible guard regions on both sides:
+//
+//   [leading guard][readable window ... corpus][trailing guard]
+//
+// Offsets read from the input point into the corpus, past its end, into the
+// leading guard, or into the null page, so every access outside the corpus
+// faults. Then:
+//   - every record is parsed with the checked parser and, inside a guard, with
+//     the unchecked one; a record the checked parser accepts must parse
+//     without a fault and with the same sum
+//   - the whole corpus is parsed in one guard, which must fault exactly when
+//     one of the records did
+//   - safeRead() and tcg_safe_read() copy ranges chosen by the input and must
+//     succeed exactly when the range is readable
+// optionally inside up to three outer guards and with a C++ exception
+// escaping them.
+//
+// After every input the harness checks that the thread is outside of every
+// guard, that no hook or cleanup list is left installed and that the library
+// recovered exactly the faults the harness saw. A fault that escapes a guard
+// reaches the fuzzer's own handler and is reported as a crash.
+//
+// Built with -fsanitize=fuzzer when the compiler supports it, otherwise with
+// the standalone driver in standalone_fuzz_main.cpp. Executions and recovered
+// faults per second are printed at exit.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "record_parser.hpp"
+#include "try_catch_guard.hpp"
+
+extern "C" {
+#include "try_catch_guard.h"
+}
+
+using namespace try_catch_guard::bench;
+
+// The library installs its own SIGSEGV handler; AddressSanitizer must leave it alone
+extern "C" const char* __asan_default_options()
+{
+    return "handle_segv=0:allow_user_segv_handler=1:detect_leaks=0";
+}
+
+namespace {
+
+#define FUZZ_CHECK(condition)                                                       \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            std::fprintf(stderr, "try_catch_guard_fuzz: check failed: %s (%s:%d)\n", \
+                         #condition, __FILE__, __LINE__);                           \
+            std::abort();                                                           \
+        }                                                                           \
+    } while (0)
+
+constexpr std::size_t guardSize = 64 * 1024;
+constexpr std::size_t windowSize = 64 * 1024;
+constexpr std::size_t maxRecords = 16;
+constexpr std::size_t maxValueBytes = 1024;
+
+// Consumes the input; reads past its end return zeros
+class InputReader {
+public:
+    InputReader(const std::uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+    std::uint8_t u8() { return position_ < size_ ? data_[position_++] : 0; }
+    std::uint16_t u16() { return static_cast<std::uint16_t>(u8() | (u8() << 8)); }
+    std::uint32_t u32() { return static_cast<std::uint32_t>(u16() | (static_cast<std::uint32_t>(u16()) << 16)); }
+
+    std::size_t remaining() const { return size_ - position_; }
+    const std::uint8_t* current() const { return data_ + position_; }
+    void skip(std::size_t count) { position_ += std::min(count, remaining()); }
+
+private:
+    const std::uint8_t* data_;
+    std::size_t size_;
+    std::size_t position_ = 0;
+};
+
+// Leading guard, readable window and trailing guard, mapped once
+struct Arena {
+    unsigned char* mapping = nullptr;
+    unsigned char* window = nullptr;
+    unsigned char* window_end = nullptr;
+
+    Arena()
+    {
+        void* memory = mmap(nullptr, guardSize + windowSize + guardSize, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        FUZZ_CHECK(memory != MAP_FAILED);
+        mapping = static_cast<unsigned char*>(memory);
+        window = mapping + guardSize;
+        window_end = window + windowSize;
+        FUZZ_CHECK(mprotect(window, windowSize, PROT_READ | PROT_WRITE) == 0);
+    }
+
+    bool readable(std::uintptr_t begin, std::size_t size) const
+    {
+        std::uintptr_t low = reinterpret_cast<std::uintptr_t>(window);
+        std::uintptr_t high = reinterpret_cast<std::uintptr_t>(window_end);
+        return begin >= low && begin <= high && size <= high - begin;
+    }
+};
+
+Arena& arena()
+{
+    static Arena instance;
+    return instance;
+}
+
+struct FuzzReport {
+    std::uint64_t executions = 0;
+    std::uint64_t faults = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    ~FuzzReport()
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (executions == 0 || seconds <= 0.0) {
+            return;
+        }
+        std::fprintf(stderr,
+                     "try_catch_guard_fuzz: %llu executions in %.2f s (%.0f exec/s), "
+                     "%llu faults recovered (%.0f faults/s)\n",
+                     static_cast<unsigned long long>(executions), seconds, executions / seconds,
+                     static_cast<unsigned long long>(faults), faults / seconds);
+    }
+};
+
+FuzzReport report;
+
+// Offset from `base` chosen by the input: inside the corpus, past its end,
+// in the leading guard or in the null page
+std::uint64_t chooseOffset(InputReader& in, const unsigned char* base, std::uint64_t corpus_size)
+{
+    std::uint8_t mode = in.u8() % 8;
+    std::uint32_t raw = in.u32();
+    std::uintptr_t base_address = reinterpret_cast<std::uintptr_t>(base);
+
+    switch (mode) {
+    case 5:
+        return corpus_size + raw % guardSize;
+    case 6: {
+        std::uintptr_t target = reinterpret_cast<std::uintptr_t>(arena().mapping) + raw % guardSize;
+        return static_cast<std::uint64_t>(target - base_address);
+    }
+    case 7: {
+        // Other wild addresses are left out: AddressSanitizer's memcpy
+        // interceptor reports addresses in its shadow gap before they fault
+        std::uintptr_t target = raw % 4096;
+        return static_cast<std::uint64_t>(target - base_address);
+    }
+    default:
+        return raw % corpus_size;
+    }
+}
+
+struct CorpusView {
+    const unsigned char* base;
+    std::uint64_t size;
+    const std::uint64_t* table;
+    std::uint64_t records;
+};
+
+// Writes a corpus described by the input at the end of the readable window
+CorpusView buildCorpus(InputReader& in)
+{
+    Arena& memory = arena();
+    std::uint64_t records = in.u8() % maxRecords + 1;
+    std::size_t value_bytes = std::min(in.remaining(), maxValueBytes);
+
+    std::uint64_t headers_offset = sizeof(CorpusHeader);
+    std::uint64_t values_offset = headers_offset + records * sizeof(RecordHeader);
+    std::uint64_t table_offset = (values_offset + value_bytes + 7) & ~std::uint64_t(7);
+    std::uint64_t size = table_offset + records * sizeof(std::uint64_t);
+
+    // The corpus ends where the trailing guard begins
+    unsigned char* base = memory.window_end - size;
+    std::memset(memory.window, 0, windowSize);
+    std::memcpy(base + values_offset, in.current(), value_bytes);
+    in.skip(value_bytes);
+
+    CorpusHeader header { records, table_offset };
+    std::memcpy(base, &header, sizeof(header));
+
+    std::uint64_t* table = reinterpret_cast<std::uint64_t*>(base + table_offset);
+    for (std::uint64_t i = 0; i < records; ++i)
+    {
+        RecordHeader* record = reinterpret_cast<RecordHeader*>(base + headers_offset + i * sizeof(RecordHeader));
+        record->magic = (in.u8() & 7) ? recordMagic : in.u32();
+        record->count = in.u16();
+        record->values_offset = chooseOffset(in, base, size);
+        table[i] = (in.u8() & 3) ? headers_offset + i * sizeof(RecordHeader) : chooseOffset(in, base, size);
+    }
+
+    return CorpusView { base, size, table, records };
+}
+
+// Per-record and batched parses; returns the faults recovered
+std::uint64_t fuzzParser(const CorpusView& corpus)
+{
+    std::uint64_t faults = 0;
+    ParseTotals per_record;
+
+    for (std::uint64_t i = 0; i < corpus.records; ++i)
+    {
+        std::uint64_t checked_sum = 0;
+        bool checked = parseRecordChecked(corpus.base, corpus.size, corpus.table, i, checked_sum);
+
+        std::uint64_t sum = 0;
+        bool valid = false;
+        bool faulted = false;
+        _try {
+            valid = parseRecordUnchecked(corpus.base, corpus.table, i, sum);
+        }
+        _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+            faulted = true;
+        }
+
+        if (checked) {
+            FUZZ_CHECK(!faulted && valid && sum == checked_sum);
+        }
+        faults += faulted ? 1 : 0;
+        per_record.sum += sum;
+        per_record.valid += valid ? 1 : 0;
+    }
+
+    ParseTotals batched;
+    bool batch_faulted = false;
+    _try {
+        for (std::uint64_t i = 0; i < corpus.records; ++i) {
+            batched.valid += parseRecordUnchecked(corpus.base, corpus.table, i, batched.sum) ? 1 : 0;
+        }
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        batch_faulted = true;
+    }
+
+    FUZZ_CHECK(batch_faulted == (faults != 0));
+    if (!batch_faulted) {
+        FUZZ_CHECK(batched.sum == per_record.sum && batched.valid == per_record.valid);
+    }
+    return faults + (batch_faulted ? 1 : 0);
+}
+
+// Safe reads of ranges chosen by the input; returns the faults recovered
+std::uint64_t fuzzSafeRead(InputReader& in, const CorpusView& corpus)
+{
+    std::uint64_t faults = 0;
+    unsigned char buffer[512];
+    unsigned reads = in.u8() % 8;
+
+    for (unsigned r = 0; r < reads; ++r)
+    {
+        bool use_c_api = in.u8() & 1;
+        const unsigned char* src = corpus.base + chooseOffset(in, corpus.base, corpus.size);
+        std::size_t size = in.u16() % sizeof(buffer);
+        bool expected = size == 0 || arena().readable(reinterpret_cast<std::uintptr_t>(src), size);
+
+        bool copied = false;
+        if (use_c_api)
+        {
+            int status = tcg_safe_read(buffer, src, size);
+            if (!src && size != 0) {
+                FUZZ_CHECK(status == TCG_INVALID_ARGUMENT);
+                continue;
+            }
+            FUZZ_CHECK(status == TCG_OK || status == TCG_FAULT);
+            copied = status == TCG_OK;
+        }
+        else
+        {
+            copied = try_catch_guard::safeRead(buffer, src, size);
+        }
+
+        FUZZ_CHECK(copied == expected);
+        if (copied && size != 0) {
+            FUZZ_CHECK(std::memcmp(buffer, src, size) == 0);
+        }
+        faults += copied ? 0 : 1;
+    }
+    return faults;
+}
+
+struct EscapingException {};
+
+// Runs `body` inside `depth` outer guards of alternating kinds
+void insideOuterGuards(unsigned depth, const std::function<void()>& body)
+{
+    if (depth == 0)
+    {
+        body();
+        return;
+    }
+
+    if (depth % 2)
+    {
+        _try {
+            insideOuterGuards(depth - 1, body);
+        }
+        _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+            FUZZ_CHECK(!"fault reached an outer guard");
+        }
+    }
+    else
+    {
+        using ResultGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+        try_catch_guard::GuardResult result = ResultGuard::run([&] { insideOuterGuards(depth - 1, body); });
+        FUZZ_CHECK(!result.faulted());
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    InputReader in(data, size);
+    unsigned outer_depth = in.u8() % 4;
+    bool escape = in.u8() == 0xE5;
+
+    std::uint64_t recovered_before = try_catch_guard::getRecoveredFaultCount();
+    std::uint64_t faults = 0;
+
+    try {
+        insideOuterGuards(outer_depth, [&] {
+            CorpusView corpus = buildCorpus(in);
+            faults += fuzzParser(corpus);
+            faults += fuzzSafeRead(in, corpus);
+            if (escape) {
+                throw EscapingException();
+            }
+        });
+    }
+    catch (const EscapingException&) {
+    }
+
+    // No guard state may survive the input
+    try_catch_guard::ThreadContext* context = try_catch_guard::currentThreadContext;
+    FUZZ_CHECK(context != nullptr);
+    FUZZ_CHECK(context->jmpbuf_stack.empty());
+    FUZZ_CHECK(context->fault_cleanups == nullptr);
+    FUZZ_CHECK(context->thread_hook.handler == nullptr);
+    FUZZ_CHECK(try_catch_guard::getRecoveredFaultCount() - recovered_before == faults);
+
+    ++report.executions;
+    report.faults += faults;
+    return 0;
+}
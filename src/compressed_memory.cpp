@@ -0,0 +1,506 @@
+// Compressed memory regions (see compressed_memory.hpp).
+
+#include "compressed_memory.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace try_catch_guard {
+namespace compression {
+
+namespace {
+
+// Every change of state goes through Busy, and only the owner of a Busy page
+// touches its stale flag, its chunk or its memory. The state word of a page
+// holds its PageState in the low byte and, above it, a generation counting
+// the times the page was made accessible.
+enum PageState : std::uint8_t {
+    Compressed, // PROT_NONE, memory given back; the chunk holds the contents
+    Cold,       // PROT_NONE by the compactor, memory still there
+    Clean,      // PROT_READ, the chunk matches the memory
+    Dirty,      // PROT_READ | PROT_WRITE (writable regions)
+    Busy        // Being (de)compressed or (un)protected; faults retry
+};
+
+const std::size_t hashBits = 12;
+const std::size_t minMatch = 4;
+const std::size_t maxOffset = 65535;
+
+const std::uint32_t generationStep = 0x100;
+
+inline std::uint8_t stateOf(std::uint32_t word)
+{
+    return static_cast<std::uint8_t>(word & 0xff);
+}
+
+inline std::uint32_t withState(std::uint32_t word, std::uint8_t state)
+{
+    return (word & ~std::uint32_t(0xff)) | state;
+}
+
+// Last fault this thread retried on an accessible page, with the generation
+// the page had then: a fault at the same address in the same generation is
+// the program's own
+TRY_CATCH_GUARD_TLS void* retriedAddress = nullptr;
+TRY_CATCH_GUARD_TLS std::uint32_t retriedGeneration = 0;
+
+inline std::uint32_t read32(const unsigned char* p)
+{
+    std::uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::size_t hash32(std::uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - hashBits);
+}
+
+// Writes `length` beyond a 15 of a token nibble as 255-runs
+inline unsigned char* writeLength(unsigned char* out, std::size_t length)
+{
+    while (length >= 255)
+    {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = static_cast<unsigned char>(length);
+    return out;
+}
+
+// One sequence: token, literals, then the match unless it is the last one
+unsigned char* writeSequence(unsigned char* out, unsigned char* out_end, const unsigned char* literals,
+                             std::size_t literal_length, std::size_t offset, std::size_t match_length)
+{
+    std::size_t worst = 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1;
+    if (worst > static_cast<std::size_t>(out_end - out)) {
+        return nullptr;
+    }
+
+    std::size_t match_code = match_length ? match_length - minMatch : 0;
+    unsigned char* token = out++;
+    *token = static_cast<unsigned char>((literal_length < 15 ? literal_length : 15) << 4 |
+                                        (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) {
+        out = writeLength(out, literal_length - 15);
+    }
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (match_length != 0)
+    {
+        *out++ = static_cast<unsigned char>(offset & 0xff);
+        *out++ = static_cast<unsigned char>(offset >> 8);
+        if (match_code >= 15) {
+            out = writeLength(out, match_code - 15);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+// Greedy LZ77 with a single-entry hash table of 4-byte sequences. Each
+// sequence is a token (literal length << 4 | match length - 4, 15 meaning
+// more length bytes follow), the literals and a 16-bit offset; the last
+// sequence has literals only.
+std::size_t compressBlock(const void* src, std::size_t size, void* dst, std::size_t capacity)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    const unsigned char* in_end = in + size;
+    const unsigned char* anchor = in;
+    unsigned char* out = static_cast<unsigned char*>(dst);
+    unsigned char* out_end = out + capacity;
+    if (size > maxOffset + 1) {
+        return 0;
+    }
+
+    std::uint16_t table[std::size_t(1) << hashBits] = {}; // Position + 1, 0 if none
+    const unsigned char* p = in;
+    while (in_end - p >= static_cast<std::ptrdiff_t>(minMatch))
+    {
+        std::uint32_t sequence = read32(p);
+        std::size_t slot = hash32(sequence);
+        std::size_t candidate = table[slot];
+        table[slot] = static_cast<std::uint16_t>(p - in + 1);
+
+        const unsigned char* match = in + candidate - 1;
+        if (candidate == 0 || read32(match) != sequence)
+        {
+            ++p;
+            continue;
+        }
+
+        std::size_t length = minMatch;
+        while (p + length < in_end && p[length] == match[length]) {
+            ++length;
+        }
+        out = writeSequence(out, out_end, anchor, static_cast<std::size_t>(p - anchor),
+                            static_cast<std::size_t>(p - match), length);
+        if (!out) {
+            return 0;
+        }
+        p += length;
+        anchor = p;
+    }
+
+    out = writeSequence(out, out_end, anchor, static_cast<std::size_t>(in_end - anchor), 0, 0);
+    return out ? static_cast<std::size_t>(out - static_cast<unsigned char*>(dst)) : 0;
+}
+
+std::size_t decompressBlock(const void* src, std::size_t size, void* dst, std::size_t capacity)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    const unsigned char* in_end = in + size;
+    unsigned char* out = static_cast<unsigned char*>(dst);
+    unsigned char* out_end = out + capacity;
+
+    while (in < in_end)
+    {
+        unsigned token = *in++;
+
+        std::size_t literal_length = token >> 4;
+        if (literal_length == 15)
+        {
+            unsigned char more;
+            do {
+                if (in == in_end) {
+                    return 0;
+                }
+                more = *in++;
+                literal_length += more;
+            } while (more == 255);
+        }
+        if (literal_length > static_cast<std::size_t>(in_end - in) ||
+            literal_length > static_cast<std::size_t>(out_end - out)) {
+            return 0;
+        }
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        if (in == in_end) {
+            return static_cast<std::size_t>(out - static_cast<unsigned char*>(dst));
+        }
+
+        if (in_end - in < 2) {
+            return 0;
+        }
+        std::size_t offset = in[0] | std::size_t(in[1]) << 8;
+        in += 2;
+        if (offset == 0 || offset > static_cast<std::size_t>(out - static_cast<unsigned char*>(dst))) {
+            return 0;
+        }
+
+        std::size_t match_length = (token & 15) + minMatch;
+        if ((token & 15) == 15)
+        {
+            unsigned char more;
+            do {
+                if (in == in_end) {
+                    return 0;
+                }
+                more = *in++;
+                match_length += more;
+            } while (more == 255);
+        }
+        if (match_length > static_cast<std::size_t>(out_end - out)) {
+            return 0;
+        }
+        // The match may overlap the bytes it produces. It repeats with the
+        // offset as period, so every copy reaches back to the start of the
+        // match and copies all that was written so far, doubling each time.
+        std::size_t distance = offset;
+        for (std::size_t i = 0; i < match_length; distance = i + offset)
+        {
+            std::size_t chunk = distance < match_length - i ? distance : match_length - i;
+            memcpy(out + i, out + i - distance, chunk);
+            i += chunk;
+        }
+        out += match_length;
+    }
+    return 0; // No final sequence
+}
+
+CompressedRegion::CompressedRegion(std::size_t size, const CompressedRegionOptions& options)
+    : view_(nullptr),
+      alias_(nullptr),
+      fd_(-1),
+      page_size_(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+      pages_((size + page_size_ - 1) / page_size_),
+      options_(options),
+      states_(new std::atomic<std::uint32_t>[pages_ + 1]),
+      stale_(new bool[pages_ + 1]),
+      chunks_(new unsigned char*[pages_ + 1]()),
+      chunk_sizes_(new std::uint32_t[pages_ + 1]()),
+      decompressions_(0),
+      soft_faults_(0),
+      compressions_(0),
+      compactor_stop_(false),
+      clock_hand_(0)
+{
+    std::size_t bytes = pages_ * page_size_;
+    if (pages_ == 0) {
+        throw std::bad_alloc();
+    }
+
+    // Both views share the pages of one memory file: the handler fills a page
+    // through the alias while the view still faults
+    fd_ = memfd_create("try_catch_guard_compressed", MFD_CLOEXEC);
+    if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+    {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw std::bad_alloc();
+    }
+    void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    void* alias = view == MAP_FAILED ? MAP_FAILED : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (alias == MAP_FAILED)
+    {
+        if (view != MAP_FAILED) {
+            munmap(view, bytes);
+        }
+        close(fd_);
+        throw std::bad_alloc();
+    }
+    view_ = static_cast<char*>(view);
+    alias_ = static_cast<char*>(alias);
+
+    // Nothing was compressed yet: every page is resident and writable
+    for (std::size_t page = 0; page < pages_; ++page)
+    {
+        states_[page].store(Dirty, std::memory_order_relaxed); // Generation 0
+        stale_[page] = true;
+    }
+
+    if (!addRangeFaultHook(view_, bytes, onFault, this))
+    {
+        munmap(view_, bytes);
+        munmap(alias_, bytes);
+        close(fd_);
+        throw std::bad_alloc();
+    }
+}
+
+CompressedRegion::~CompressedRegion()
+{
+    stopCompactor();
+    removeRangeFaultHook(view_);
+    munmap(view_, pages_ * page_size_);
+    munmap(alias_, pages_ * page_size_);
+    close(fd_);
+    for (std::size_t page = 0; page < pages_; ++page) {
+        free(chunks_[page]);
+    }
+}
+
+// A fault on a page that is accessible (another thread made it so after the
+// fault was raised) is retried. The retry is tagged with the page's
+// generation: if the same thread faults again at the same address while the
+// page was not made accessible again in between, the access itself is not
+// allowed (a write to a read-only region) and goes to the guard.
+FaultAction CompressedRegion::onFault(void* context, int signal, siginfo_t* info, void*)
+{
+    CompressedRegion* region = static_cast<CompressedRegion*>(context);
+    if (signal != SIGSEGV || !info || info->si_code != SEGV_ACCERR) {
+        return FaultAction::Continue;
+    }
+
+    std::size_t page = (static_cast<char*>(info->si_addr) - region->view_) / region->page_size_;
+    char* view_page = region->view_ + page * region->page_size_;
+    std::atomic<std::uint32_t>& state = region->states_[page];
+
+    std::uint32_t word = state.load(std::memory_order_acquire);
+    std::uint8_t current = stateOf(word);
+    if (current == Busy)
+    {
+        sched_yield();
+        return FaultAction::Resume;
+    }
+    if (current == Dirty || (current == Clean && !region->options_.writable))
+    {
+        std::uint32_t generation = word / generationStep;
+        if (retriedAddress == info->si_addr && retriedGeneration == generation)
+        {
+            retriedAddress = nullptr;
+            return FaultAction::Continue;
+        }
+        retriedAddress = info->si_addr;
+        retriedGeneration = generation;
+        return FaultAction::Resume;
+    }
+    if (!state.compare_exchange_strong(word, withState(word, Busy), std::memory_order_acquire)) {
+        return FaultAction::Resume;
+    }
+
+    std::uint8_t next = current;
+    int protection = PROT_READ;
+    if (current == Compressed)
+    {
+        char* alias_page = region->alias_ + page * region->page_size_;
+        std::size_t size = region->chunk_sizes_[page];
+        if (size == region->page_size_) {
+            memcpy(alias_page, region->chunks_[page], size);
+        }
+        else if (decompressBlock(region->chunks_[page], size, alias_page, region->page_size_) != region->page_size_)
+        {
+            state.store(word, std::memory_order_release);
+            return FaultAction::Continue;
+        }
+        region->decompressions_.fetch_add(1, std::memory_order_relaxed);
+        next = Clean;
+    }
+    else if (current == Cold)
+    {
+        region->soft_faults_.fetch_add(1, std::memory_order_relaxed);
+        next = region->stale_[page] ? Dirty : Clean;
+    }
+    else // A write to a clean page of a writable region
+    {
+        region->stale_[page] = true;
+        next = Dirty;
+    }
+    if (next == Dirty) {
+        protection |= PROT_WRITE;
+    }
+
+    if (mprotect(view_page, region->page_size_, protection) != 0)
+    {
+        state.store(word, std::memory_order_release);
+        return FaultAction::Continue;
+    }
+    state.store(withState(word + generationStep, next), std::memory_order_release);
+    return FaultAction::Resume;
+}
+
+// A resident page is only protected: if it is touched before the hand comes
+// back, the fault just gives its protection back. A page still cold then is
+// compressed (unless its last compression still matches) and its memory is
+// punched out of the memory file.
+void CompressedRegion::compactPage(std::size_t page)
+{
+    std::atomic<std::uint32_t>& state = states_[page];
+    std::uint32_t word = state.load(std::memory_order_acquire);
+    std::uint8_t current = stateOf(word);
+    if (current == Compressed || current == Busy ||
+        !state.compare_exchange_strong(word, withState(word, Busy), std::memory_order_acquire)) {
+        return;
+    }
+
+    std::size_t offset = page * page_size_;
+    if (current != Cold)
+    {
+        mprotect(view_ + offset, page_size_, PROT_NONE);
+        state.store(withState(word, Cold), std::memory_order_release);
+        return;
+    }
+
+    if (stale_[page] || !chunks_[page])
+    {
+        unsigned char buffer[65536];
+        std::size_t capacity = page_size_ - 1 < sizeof(buffer) ? page_size_ - 1 : sizeof(buffer);
+        std::size_t size = compressBlock(alias_ + offset, page_size_, buffer, capacity);
+        const unsigned char* source = buffer;
+        if (size == 0) // Stored as it is
+        {
+            size = page_size_;
+            source = reinterpret_cast<const unsigned char*>(alias_ + offset);
+        }
+
+        unsigned char* chunk = static_cast<unsigned char*>(malloc(size));
+        if (!chunk)
+        {
+            state.store(word, std::memory_order_release);
+            return;
+        }
+        memcpy(chunk, source, size);
+        free(chunks_[page]);
+        chunks_[page] = chunk;
+        chunk_sizes_[page] = static_cast<std::uint32_t>(size);
+        stale_[page] = false;
+        ++compressions_;
+    }
+
+    fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(page_size_));
+    state.store(withState(word, Compressed), std::memory_order_release);
+}
+
+void CompressedRegion::compactAll()
+{
+    std::lock_guard<std::mutex> lock(compactor_mutex_);
+    for (std::size_t page = 0; page < pages_; ++page)
+    {
+        compactPage(page); // Protect
+        compactPage(page); // Compress
+    }
+}
+
+void CompressedRegion::startCompactor(const CompactorOptions& options)
+{
+    std::lock_guard<std::mutex> lock(compactor_mutex_);
+    if (compactor_.joinable()) {
+        return;
+    }
+    compactor_stop_ = false;
+    compactor_ = std::thread(&CompressedRegion::runCompactor, this, options);
+}
+
+void CompressedRegion::stopCompactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(compactor_mutex_);
+        compactor_stop_ = true;
+    }
+    compactor_wakeup_.notify_all();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+}
+
+void CompressedRegion::runCompactor(CompactorOptions options)
+{
+    std::size_t step = options.pages_per_step ? options.pages_per_step : 1;
+    std::unique_lock<std::mutex> lock(compactor_mutex_);
+    while (!compactor_stop_)
+    {
+        for (std::size_t i = 0; i < step && i < pages_; ++i)
+        {
+            compactPage(clock_hand_);
+            clock_hand_ = (clock_hand_ + 1) % pages_;
+        }
+        compactor_wakeup_.wait_for(lock, std::chrono::milliseconds(options.interval_ms),
+                                   [this] { return compactor_stop_; });
+    }
+}
+
+CompressedRegionStats CompressedRegion::stats() const
+{
+    std::lock_guard<std::mutex> lock(compactor_mutex_);
+    CompressedRegionStats stats;
+    stats.pages = pages_;
+    for (std::size_t page = 0; page < pages_; ++page)
+    {
+        if (stateOf(states_[page].load(std::memory_order_relaxed)) == Compressed)
+        {
+            ++stats.compressed_pages;
+            stats.compressed_bytes += chunk_sizes_[page];
+        }
+        else {
+            ++stats.resident_pages;
+        }
+    }
+    stats.decompressions = decompressions_.load(std::memory_order_relaxed);
+    stats.soft_faults = soft_faults_.load(std::memory_order_relaxed);
+    stats.compressions = compressions_;
+    return stats;
+}
+
+} // namespace compression
+} // namespace try_catch_guard
@@ -0,0 +1,133 @@
+#ifndef TRY_CATCH_GUARD_COMPRESSED_MEMORY_HPP
+#define TRY_CATCH_GUARD_COMPRESSED_MEMORY_HPP
+
+// Memory regions kept compressed while they are not used.
+//
+// A CompressedRegion reserves a virtual range whose pages are only
+// accessible while they are resident. Touching a compressed page faults; a
+// range hook (see addRangeFaultHook()) decompresses the page in place,
+// makes it accessible and resumes the access. A background compactor sweeps
+// the region like a clock: it protects the resident pages it passes, and a
+// page that was not touched again by the next sweep is compressed and its
+// memory given back to the system:
+//
+//   compression::CompressedRegion table(1 << 30);
+//   buildLookupTable(table.data());       // ordinary writes
+//   table.compactAll();                   // compress everything now
+//   table.startCompactor();               // and whatever goes cold later
+//   ...
+//   lookup(table.data(), key);            // decompresses on first access
+//
+// The first access to a compressed page costs a fault plus the
+// decompression of one page; the first access to a page the compactor only
+// protected costs a fault. Pages are written to memory shared with a second
+// mapping of the region, so other threads never see a page that is being
+// decompressed or compressed: they fault and retry until it is done.
+//
+// The codec is a byte-oriented LZ77 (compressBlock()/decompressBlock()),
+// fast enough to run in the signal handler; pages that do not compress are
+// stored as they are. Writes made by the kernel (e.g. read() into the
+// region) do not fault and fail with EFAULT on a page that is not resident.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "try_catch_guard.hpp"
+
+namespace try_catch_guard {
+namespace compression {
+
+// Compresses `size` bytes of `src` into `dst`; returns the compressed size,
+// or 0 if it does not fit in `capacity`. Blocks are at most 64 KiB.
+std::size_t compressBlock(const void* src, std::size_t size, void* dst, std::size_t capacity);
+
+// Decompresses a block made by compressBlock(); returns the decompressed
+// size, or 0 if the block is malformed or does not fit in `capacity`.
+// Does not allocate, so it can run in a signal handler.
+std::size_t decompressBlock(const void* src, std::size_t size, void* dst, std::size_t capacity);
+
+struct CompressedRegionOptions {
+    bool writable = true; // Resident pages can be written (compressed again when they go cold)
+};
+
+struct CompactorOptions {
+    unsigned interval_ms = 100;      // Time between two steps of the clock hand
+    std::size_t pages_per_step = 256; // Pages the hand passes per step
+};
+
+struct CompressedRegionStats {
+    std::size_t pages = 0;
+    std::size_t resident_pages = 0;   // Pages in memory (accessible or protected by the compactor)
+    std::size_t compressed_pages = 0; // Pages only in compressed form
+    std::size_t compressed_bytes = 0; // Memory held by compressed pages, including stored ones
+    std::uint64_t decompressions = 0; // First accesses to compressed pages
+    std::uint64_t soft_faults = 0;    // First accesses to pages the compactor protected
+    std::uint64_t compressions = 0;   // Pages compressed (clean pages reuse their last compression)
+};
+
+class CompressedRegion {
+public:
+    // Reserves `size` bytes, rounded up to whole pages. Every page starts
+    // resident, zeroed and writable, so the contents can be written before
+    // the first compaction. Throws std::bad_alloc on failure.
+    explicit CompressedRegion(std::size_t size, const CompressedRegionOptions& options = CompressedRegionOptions());
+    ~CompressedRegion(); // Stops the compactor
+
+    CompressedRegion(const CompressedRegion&) = delete;
+    CompressedRegion& operator=(const CompressedRegion&) = delete;
+
+    void* data() const { return view_; }
+    std::size_t size() const { return pages_ * page_size_; }
+    std::size_t pageSize() const { return page_size_; }
+
+    // Compresses every page that is not being accessed, now
+    void compactAll();
+
+    // Starts the background compactor (once); stopCompactor() ends it
+    void startCompactor(const CompactorOptions& options = CompactorOptions());
+    void stopCompactor();
+
+    CompressedRegionStats stats() const;
+
+private:
+    static FaultAction onFault(void* context, int signal, siginfo_t* info, void* ucontext);
+
+    // One step of the clock for `page`: protect a resident page, compress a
+    // protected one. Caller holds compactor_mutex_.
+    void compactPage(std::size_t page);
+    void runCompactor(CompactorOptions options);
+
+    char* view_;  // Mapping seen by the program
+    char* alias_; // Second mapping of the same pages, always writable
+    int fd_;
+    std::size_t page_size_;
+    std::size_t pages_;
+    CompressedRegionOptions options_;
+
+    std::unique_ptr<std::atomic<std::uint32_t>[]> states_; // PageState and generation of every page
+    std::unique_ptr<bool[]> stale_;                       // Contents differ from the compressed copy
+    std::unique_ptr<unsigned char*[]> chunks_;            // Compressed copy, allocated by the compactor
+    std::unique_ptr<std::uint32_t[]> chunk_sizes_;        // Equal to the page size for stored pages
+
+    std::atomic<std::uint64_t> decompressions_;
+    std::atomic<std::uint64_t> soft_faults_;
+    std::uint64_t compressions_;
+
+    mutable std::mutex compactor_mutex_;
+    std::condition_variable compactor_wakeup_;
+    std::thread compactor_;
+    bool compactor_stop_;
+    std::size_t clock_hand_;
+};
+
+} // namespace compression
+
+using compression::CompressedRegion;
+
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_COMPRESSED_MEMORY_HPP
@@ -0,0 +1,147 @@
+#ifndef TRY_CATCH_GUARD_CONTEXT_CAPTURE_HPP
+#define TRY_CATCH_GUARD_CONTEXT_CAPTURE_HPP
+
+// Context-capture backends used by the guards to return from the signal handler.
+//
+// Every backend provides a context type, a capture macro that returns 0 when
+// the context is captured and the resume value when execution comes back to
+// it, and resumeContext(context, value):
+//   - SetjmpContext:    glibc setjmp/longjmp
+//   - SigsetjmpContext: sigsetjmp(env, 0)/siglongjmp (no signal mask saved)
+//   - BuiltinContext:   GCC/Clang __builtin_setjmp/__builtin_longjmp
+//   - AsmContext:       x86-64 only; saves rbx, rbp, r12-r15, rsp and rip,
+//                       with no pointer mangling, no signal mask and no CET
+//                       shadow-stack pointer, so it is not available when
+//                       return protection is on (-fcf-protection=return/full)
+// The capture must be a macro: it has to run in the frame that is resumed.
+//
+// The library uses the backend selected by TRY_CATCH_GUARD_CONTEXT_BACKEND
+// (see CaptureContext); all backends stay available for the benchmarks.
+
+#include <csetjmp>
+
+// The resume skips the frames between the handler and the guard, so
+// AddressSanitizer must forget their poisoned locals first. The library is
+// usually built without it while the program is, so the check is made at run
+// time: the weak symbol is only defined when the ASan runtime is loaded.
+extern "C" void __asan_handle_no_return(void) __attribute__((weak));
+
+#define TRY_CATCH_GUARD_BEFORE_RESUME() \
+    (::__asan_handle_no_return ? ::__asan_handle_no_return() : (void)0)
+
+#define TRY_CATCH_GUARD_BACKEND_SETJMP 1
+#define TRY_CATCH_GUARD_BACKEND_SIGSETJMP 2
+#define TRY_CATCH_GUARD_BACKEND_BUILTIN 3
+#define TRY_CATCH_GUARD_BACKEND_ASM 4
+
+#ifndef TRY_CATCH_GUARD_CONTEXT_BACKEND
+#define TRY_CATCH_GUARD_CONTEXT_BACKEND TRY_CATCH_GUARD_BACKEND_SETJMP
+#endif
+
+// The shadow stack of CET (bit 1 of __CET__) would not match the stack
+// pointer the asm resume restores
+#if defined(__x86_64__) && !(defined(__CET__) && (__CET__ & 2))
+#define TRY_CATCH_GUARD_HAS_ASM_CONTEXT 1
+#else
+#define TRY_CATCH_GUARD_HAS_ASM_CONTEXT 0
+#endif
+
+#if TRY_CATCH_GUARD_CONTEXT_BACKEND == TRY_CATCH_GUARD_BACKEND_ASM && !TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+#error "The asm context backend is only available on x86-64 without -fcf-protection=return"
+#endif
+
+namespace try_catch_guard {
+namespace context {
+
+// glibc setjmp/longjmp
+struct SetjmpContext {
+    jmp_buf env;
+};
+
+#define TRY_CATCH_GUARD_SETJMP_CAPTURE(ctx) setjmp((ctx).env)
+
+[[noreturn]] inline void resumeContext(SetjmpContext& ctx, int value)
+{
+    TRY_CATCH_GUARD_BEFORE_RESUME();
+    longjmp(ctx.env, value);
+}
+
+// sigsetjmp without saving the signal mask
+struct SigsetjmpContext {
+    sigjmp_buf env;
+};
+
+#define TRY_CATCH_GUARD_SIGSETJMP_CAPTURE(ctx) sigsetjmp((ctx).env, 0)
+
+[[noreturn]] inline void resumeContext(SigsetjmpContext& ctx, int value)
+{
+    TRY_CATCH_GUARD_BEFORE_RESUME();
+    siglongjmp(ctx.env, value);
+}
+
+// __builtin_setjmp saves only the frame pointer, the stack pointer and the
+// resume address; __builtin_longjmp can only pass 1, so the value travels
+// through the context
+struct BuiltinContext {
+    void* env[5];
+    int value;
+};
+
+#define TRY_CATCH_GUARD_BUILTIN_CAPTURE(ctx) \
+    (__builtin_setjmp((ctx).env) ? static_cast<volatile int&>((ctx).value) : 0)
+
+[[noreturn]] inline void resumeContext(BuiltinContext& ctx, int value)
+{
+    TRY_CATCH_GUARD_BEFORE_RESUME();
+    ctx.value = value;
+    __builtin_longjmp(ctx.env, 1);
+}
+
+#if TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+
+// Callee-saved registers only: rbx, rbp, r12, r13, r14, r15, rsp, rip
+struct AsmContext {
+    void* registers[8];
+};
+
+// Implemented in assembly in try_catch_guard.cpp
+extern "C" int tcg_asm_context_capture(void** registers) __attribute__((returns_twice, nothrow));
+extern "C" [[noreturn]] void tcg_asm_context_resume(void** registers, int value);
+
+#define TRY_CATCH_GUARD_ASM_CAPTURE(ctx) ::try_catch_guard::context::tcg_asm_context_capture((ctx).registers)
+
+[[noreturn]] inline void resumeContext(AsmContext& ctx, int value)
+{
+    TRY_CATCH_GUARD_BEFORE_RESUME();
+    tcg_asm_context_resume(ctx.registers, value);
+}
+
+#endif
+
+} // namespace context
+
+// Backend used by the library. It must be the same in every translation unit,
+// so the build defines TRY_CATCH_GUARD_CONTEXT_BACKEND for all of them.
+#if TRY_CATCH_GUARD_CONTEXT_BACKEND == TRY_CATCH_GUARD_BACKEND_SETJMP
+using CaptureContext = context::SetjmpContext;
+#define TRY_CATCH_GUARD_CAPTURE(ctx) TRY_CATCH_GUARD_SETJMP_CAPTURE(ctx)
+#define TRY_CATCH_GUARD_BACKEND_NAME "setjmp"
+#elif TRY_CATCH_GUARD_CONTEXT_BACKEND == TRY_CATCH_GUARD_BACKEND_SIGSETJMP
+using CaptureContext = context::SigsetjmpContext;
+#define TRY_CATCH_GUARD_CAPTURE(ctx) TRY_CATCH_GUARD_SIGSETJMP_CAPTURE(ctx)
+#define TRY_CATCH_GUARD_BACKEND_NAME "sigsetjmp"
+#elif TRY_CATCH_GUARD_CONTEXT_BACKEND == TRY_CATCH_GUARD_BACKEND_BUILTIN
+using CaptureContext = context::BuiltinContext;
+#define TRY_CATCH_GUARD_CAPTURE(ctx) TRY_CATCH_GUARD_BUILTIN_CAPTURE(ctx)
+#define TRY_CATCH_GUARD_BACKEND_NAME "builtin"
+#elif TRY_CATCH_GUARD_CONTEXT_BACKEND == TRY_CATCH_GUARD_BACKEND_ASM
+using CaptureContext = context::AsmContext;
+#define TRY_CATCH_GUARD_CAPTURE(ctx) TRY_CATCH_GUARD_ASM_CAPTURE(ctx)
+#define TRY_CATCH_GUARD_BACKEND_NAME "asm"
+#else
+#error "Unknown TRY_CATCH_GUARD_CONTEXT_BACKEND"
+#endif
+
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_CONTEXT_CAPTURE_HPP
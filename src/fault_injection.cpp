@@ -0,0 +1,230 @@
+// Fault injection (see fault_injection.hpp).
+
+#include "fault_injection.hpp"
+#include "try_catch_guard.hpp"
+
+#include <mutex>
+
+#include <pthread.h>
+
+namespace try_catch_guard {
+namespace injection {
+
+std::atomic<bool> injectionEnabled(false);
+
+struct SiteAccess {
+    static std::atomic<bool>& enabled(FaultSite& site) { return site.enabled_; }
+    static std::atomic<std::uint64_t>& threshold(FaultSite& site) { return site.threshold_; }
+    static std::atomic<std::uint64_t>& evaluations(FaultSite& site) { return site.evaluations_; }
+    static std::atomic<std::uint64_t>& injected(FaultSite& site) { return site.injected_; }
+    static FaultSite*& next(FaultSite& site) { return site.next_; }
+};
+
+namespace {
+
+constexpr double thresholdScale = 9007199254740992.0; // 2^53
+
+// Configuration by name, kept for sites that are not registered yet
+struct SiteConfig {
+    std::string name;
+    double probability;
+    bool enabled;
+};
+
+struct Injector {
+    std::mutex mutex;
+    FaultSite* sites = nullptr;
+    std::vector<SiteConfig> configs;
+    std::atomic<std::uint64_t> seed{0};
+    std::atomic<std::uint64_t> generation{0};
+    std::atomic<std::uint64_t> nextStream{0};
+    std::atomic<Delivery> delivery{Delivery::Signal};
+};
+
+Injector& getInjector()
+{
+    static Injector injector;
+    return injector;
+}
+
+// Per-thread generator; restarted when the generation changes
+struct ThreadStream {
+    std::uint64_t state = 0;
+    std::uint64_t generation = ~std::uint64_t(0);
+    std::uint64_t stream = 0;
+    bool has_stream = false;
+};
+
+thread_local ThreadStream threadStream;
+
+std::uint64_t splitmix64(std::uint64_t& state)
+{
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void restartStream(ThreadStream& thread, Injector& injector)
+{
+    if (!thread.has_stream)
+    {
+        thread.stream = injector.nextStream.fetch_add(1, std::memory_order_relaxed);
+        thread.has_stream = true;
+    }
+    std::uint64_t mix = thread.stream;
+    thread.state = injector.seed.load(std::memory_order_relaxed) ^ splitmix64(mix);
+    thread.generation = injector.generation.load(std::memory_order_acquire);
+}
+
+std::uint64_t thresholdFor(double probability)
+{
+    if (probability <= 0.0) {
+        return 0;
+    }
+    if (probability >= 1.0) {
+        return std::uint64_t(1) << 53;
+    }
+    return static_cast<std::uint64_t>(probability * thresholdScale);
+}
+
+// Applies the named configuration to a registered site; caller holds the mutex
+void applyConfig(FaultSite& site, const SiteConfig& config)
+{
+    SiteAccess::threshold(site).store(thresholdFor(config.probability), std::memory_order_relaxed);
+    SiteAccess::enabled(site).store(config.enabled, std::memory_order_relaxed);
+}
+
+SiteConfig& findConfig(Injector& injector, const char* name)
+{
+    for (SiteConfig& config : injector.configs)
+    {
+        if (config.name == name) {
+            return config;
+        }
+    }
+    injector.configs.push_back(SiteConfig{ name, 0.0, false });
+    return injector.configs.back();
+}
+
+void updateSites(Injector& injector, const SiteConfig& config)
+{
+    for (FaultSite* site = injector.sites; site; site = SiteAccess::next(*site))
+    {
+        if (config.name == site->name()) {
+            applyConfig(*site, config);
+        }
+    }
+}
+
+} // namespace
+
+FaultSite::FaultSite(const char* name)
+    : name_(name), enabled_(false), threshold_(0), evaluations_(0), injected_(0), next_(nullptr)
+{
+    Injector& injector = getInjector();
+    std::lock_guard<std::mutex> lock(injector.mutex);
+    applyConfig(*this, findConfig(injector, name));
+    next_ = injector.sites;
+    injector.sites = this;
+}
+
+void enable(std::uint64_t seed, Delivery delivery)
+{
+    Injector& injector = getInjector();
+    injector.seed.store(seed, std::memory_order_relaxed);
+    injector.delivery.store(delivery, std::memory_order_relaxed);
+    injector.generation.fetch_add(1, std::memory_order_release);
+    injectionEnabled.store(true, std::memory_order_release);
+}
+
+void disable()
+{
+    injectionEnabled.store(false, std::memory_order_release);
+}
+
+void setSiteProbability(const char* name, double probability)
+{
+    Injector& injector = getInjector();
+    std::lock_guard<std::mutex> lock(injector.mutex);
+    SiteConfig& config = findConfig(injector, name);
+    config.probability = probability;
+    config.enabled = true;
+    updateSites(injector, config);
+}
+
+void setSiteEnabled(const char* name, bool enabled)
+{
+    Injector& injector = getInjector();
+    std::lock_guard<std::mutex> lock(injector.mutex);
+    SiteConfig& config = findConfig(injector, name);
+    config.enabled = enabled;
+    updateSites(injector, config);
+}
+
+void setThreadStream(std::uint64_t stream)
+{
+    threadStream.stream = stream;
+    threadStream.has_stream = true;
+    restartStream(threadStream, getInjector());
+}
+
+std::vector<SiteStats> siteStats()
+{
+    Injector& injector = getInjector();
+    std::lock_guard<std::mutex> lock(injector.mutex);
+
+    std::vector<SiteStats> stats;
+    for (const SiteConfig& config : injector.configs)
+    {
+        SiteStats entry;
+        entry.name = config.name;
+        entry.probability = config.probability;
+        entry.enabled = config.enabled;
+        for (FaultSite* site = injector.sites; site; site = SiteAccess::next(*site))
+        {
+            if (config.name == site->name())
+            {
+                entry.evaluations += SiteAccess::evaluations(*site).load(std::memory_order_relaxed);
+                entry.injected += SiteAccess::injected(*site).load(std::memory_order_relaxed);
+            }
+        }
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+void maybeInject(FaultSite& site)
+{
+    if (!SiteAccess::enabled(site).load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Only inside a guard: an injected fault must never escape
+    ThreadContext* thread = currentThreadContext;
+    if (!thread || thread->jmpbuf_stack.empty()) {
+        return;
+    }
+
+    Injector& injector = getInjector();
+    ThreadStream& stream = threadStream;
+    if (stream.generation != injector.generation.load(std::memory_order_acquire)) {
+        restartStream(stream, injector);
+    }
+
+    SiteAccess::evaluations(site).fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t draw = splitmix64(stream.state) >> 11;
+    if (draw >= SiteAccess::threshold(site).load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    SiteAccess::injected(site).fetch_add(1, std::memory_order_relaxed);
+    if (injector.delivery.load(std::memory_order_relaxed) == Delivery::Simulated) {
+        simulateFault(SIGSEGV, &site);
+    } else {
+        pthread_kill(pthread_self(), SIGSEGV);
+    }
+}
+
+} // namespace injection
+} // namespace try_catch_guard
@@ -0,0 +1,114 @@
+#ifndef TRY_CATCH_GUARD_FAULT_INJECTION_HPP
+#define TRY_CATCH_GUARD_FAULT_INJECTION_HPP
+
+// Deterministic fault injection for exercising recovery paths under load.
+//
+// TRY_CATCH_GUARD_FAULT_POINT("name") marks a point inside guarded code where
+// a synthetic fault may be injected. Nothing is injected until enable() is
+// called and the site has been given a probability, so a disabled fault
+// point costs one relaxed load. Defining TRY_CATCH_GUARD_NO_FAULT_INJECTION
+// removes the points entirely.
+//
+//   injection::setSiteProbability("parser.record", 0.01);
+//   injection::enable(42, injection::Delivery::Simulated);
+//
+// Decisions come from a per-thread generator seeded from the seed and the
+// thread's stream (setThreadStream(), or the order in which threads first
+// reach a fault point), so a run with the same seed, streams and calls
+// injects the same faults.
+//
+// Faults are only injected inside a guard and are delivered either as a
+// real SIGSEGV sent to the calling thread (Delivery::Signal, through the
+// library's signal handler and its hooks) or by resuming the innermost guard
+// directly (Delivery::Simulated, no kernel round trip, no hooks; the fault
+// address is the address of the FaultSite).
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace try_catch_guard {
+namespace injection {
+
+enum class Delivery {
+    Signal,
+    Simulated
+};
+
+// A registered fault point; created by TRY_CATCH_GUARD_FAULT_POINT
+class FaultSite {
+public:
+    explicit FaultSite(const char* name);
+
+    FaultSite(const FaultSite&) = delete;
+    FaultSite& operator=(const FaultSite&) = delete;
+
+    const char* name() const { return name_; }
+
+private:
+    friend struct SiteAccess;
+
+    const char* name_;
+    std::atomic<bool> enabled_;
+    std::atomic<std::uint64_t> threshold_;   // Probability scaled to 2^53
+    std::atomic<std::uint64_t> evaluations_;
+    std::atomic<std::uint64_t> injected_;
+    FaultSite* next_;
+};
+
+// Counters and configuration of one site
+struct SiteStats {
+    std::string name;
+    double probability = 0.0;
+    bool enabled = false;
+    std::uint64_t evaluations = 0; // Times the point was reached inside a guard while enabled
+    std::uint64_t injected = 0;    // Faults injected
+};
+
+extern std::atomic<bool> injectionEnabled;
+
+inline bool isEnabled()
+{
+    return injectionEnabled.load(std::memory_order_relaxed);
+}
+
+// Starts injecting with `seed`; every thread restarts its generator
+void enable(std::uint64_t seed, Delivery delivery = Delivery::Signal);
+
+// Stops injecting; the site configuration is kept
+void disable();
+
+// Sets the probability of a site (0 to 1) and enables it. The site may be
+// configured before its fault point is first reached.
+void setSiteProbability(const char* name, double probability);
+
+// Enables or disables a site without changing its probability
+void setSiteEnabled(const char* name, bool enabled);
+
+// Selects the generator stream of the calling thread, for deterministic
+// multi-threaded runs; takes effect immediately
+void setThreadStream(std::uint64_t stream);
+
+// Counters of every registered or configured site
+std::vector<SiteStats> siteStats();
+
+// Decides whether to inject at `site` and delivers the fault
+void maybeInject(FaultSite& site);
+
+} // namespace injection
+} // namespace try_catch_guard
+
+#ifdef TRY_CATCH_GUARD_NO_FAULT_INJECTION
+#define TRY_CATCH_GUARD_FAULT_POINT(name) ((void)0)
+#else
+#define TRY_CATCH_GUARD_FAULT_POINT(name)                                           \
+    do {                                                                            \
+        if (__builtin_expect(::try_catch_guard::injection::isEnabled(), 0)) {       \
+            static ::try_catch_guard::injection::FaultSite tcgFaultSite(name);      \
+            ::try_catch_guard::injection::maybeInject(tcgFaultSite);                \
+        }                                                                           \
+    } while (0)
+#endif
+
+#endif // TRY_CATCH_GUARD_FAULT_INJECTION_HPP
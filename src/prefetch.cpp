@@ -0,0 +1,215 @@
+// Page-access recording and prefetch replay (see prefetch.hpp).
+
+#include "prefetch.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <fcntl.h>
+#include <new>
+#include <unistd.h>
+
+namespace try_catch_guard {
+namespace prefetch {
+
+namespace {
+
+const char traceHeader[] = "# try_catch_guard page trace v1";
+
+} // namespace
+
+AccessRecorder::AccessRecorder(void* begin, std::size_t size, int protection)
+    : base_(static_cast<char*>(begin)),
+      page_size_(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+      pages_((size + page_size_ - 1) / page_size_),
+      protection_(protection),
+      recording_(false),
+      claimed_(new std::atomic<std::uint64_t>[(pages_ + 63) / 64 + 1]()),
+      restored_(new std::atomic<std::uint64_t>[(pages_ + 63) / 64 + 1]()),
+      order_(new std::uint32_t[pages_ + 1]),
+      count_(0)
+{
+    if (pages_ == 0 || !addRangeFaultHook(base_, pages_ * page_size_, onFault, this)) {
+        throw std::bad_alloc();
+    }
+    recording_ = true;
+    mprotect(base_, pages_ * page_size_, PROT_NONE);
+}
+
+AccessRecorder::~AccessRecorder()
+{
+    stop();
+}
+
+// The first fault on a page claims it, gives its protection back and logs
+// it. Another thread faulting on the same page meanwhile retries until the
+// protection is back; a fault on a page that was restored already is a real
+// access error and goes on to the guard.
+FaultAction AccessRecorder::onFault(void* context, int signal, siginfo_t* info, void*)
+{
+    AccessRecorder* recorder = static_cast<AccessRecorder*>(context);
+    if (signal != SIGSEGV || !info || info->si_code != SEGV_ACCERR) {
+        return FaultAction::Continue;
+    }
+
+    std::size_t page = (static_cast<char*>(info->si_addr) - recorder->base_) / recorder->page_size_;
+    std::uint64_t bit = std::uint64_t(1) << (page % 64);
+    if (recorder->claimed_[page / 64].fetch_or(bit, std::memory_order_acq_rel) & bit)
+    {
+        bool restored = recorder->restored_[page / 64].load(std::memory_order_acquire) & bit;
+        return restored ? FaultAction::Continue : FaultAction::Resume;
+    }
+
+    if (mprotect(recorder->base_ + page * recorder->page_size_, recorder->page_size_, recorder->protection_) != 0) {
+        return FaultAction::Continue;
+    }
+    recorder->restored_[page / 64].fetch_or(bit, std::memory_order_release);
+
+    std::size_t slot = recorder->count_.fetch_add(1, std::memory_order_acq_rel);
+    recorder->order_[slot] = static_cast<std::uint32_t>(page);
+    return FaultAction::Resume;
+}
+
+void AccessRecorder::stop()
+{
+    if (!recording_) {
+        return;
+    }
+    recording_ = false;
+
+    // Once the hook is gone no handler writes to the trace any more
+    mprotect(base_, pages_ * page_size_, protection_);
+    removeRangeFaultHook(base_);
+}
+
+std::vector<std::uint32_t> AccessRecorder::trace() const
+{
+    std::size_t count = count_.load(std::memory_order_acquire);
+    return std::vector<std::uint32_t>(order_.get(), order_.get() + count);
+}
+
+bool AccessRecorder::writeTrace(const char* path)
+{
+    stop();
+
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    std::size_t count = count_.load(std::memory_order_acquire);
+    bool written = std::fprintf(file, "%s page_size=%zu pages=%zu\n", traceHeader, page_size_, count) > 0;
+    for (std::size_t i = 0; i < count && written; ++i) {
+        written = std::fprintf(file, "%" PRIu32 "\n", order_[i]) > 0;
+    }
+    return std::fclose(file) == 0 && written;
+}
+
+std::vector<std::uint32_t> readTrace(const char* path)
+{
+    std::vector<std::uint32_t> trace;
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        return trace;
+    }
+
+    char header[sizeof(traceHeader)];
+    std::size_t page_size = 0;
+    std::size_t count = 0;
+    if (std::fread(header, 1, sizeof(header) - 1, file) != sizeof(header) - 1 ||
+        std::memcmp(header, traceHeader, sizeof(header) - 1) != 0 ||
+        std::fscanf(file, " page_size=%zu pages=%zu", &page_size, &count) != 2 ||
+        page_size != static_cast<std::size_t>(sysconf(_SC_PAGESIZE)))
+    {
+        std::fclose(file);
+        return trace;
+    }
+
+    trace.reserve(count);
+    std::uint32_t page = 0;
+    while (trace.size() < count && std::fscanf(file, "%" SCNu32, &page) == 1) {
+        trace.push_back(page);
+    }
+    if (trace.size() != count) {
+        trace.clear();
+    }
+    std::fclose(file);
+    return trace;
+}
+
+TraceReplay::TraceReplay(const char* path, void* begin, std::size_t size, const ReplayOptions& options)
+    : base_(static_cast<char*>(begin)),
+      page_size_(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+      options_(options),
+      trace_(readTrace(path)),
+      issued_(0),
+      calls_(0)
+{
+    if (options_.max_batch == 0) {
+        options_.max_batch = 1;
+    }
+
+    std::size_t pages = (size + page_size_ - 1) / page_size_;
+    std::size_t kept = 0;
+    for (std::uint32_t page : trace_)
+    {
+        if (page < pages) {
+            trace_[kept++] = page;
+        }
+    }
+    trace_.resize(kept);
+}
+
+TraceReplay::~TraceReplay()
+{
+    wait();
+}
+
+void TraceReplay::start()
+{
+    if (!trace_.empty() && !thread_.joinable() && issued_.load(std::memory_order_relaxed) == 0) {
+        thread_ = std::thread([this] { run(); });
+    }
+}
+
+void TraceReplay::wait()
+{
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// Runs of consecutive pages (in trace order) become one call each
+void TraceReplay::run()
+{
+    std::size_t i = 0;
+    while (i < trace_.size())
+    {
+        std::size_t first = trace_[i];
+        std::size_t length = 1;
+        while (i + length < trace_.size() && length < options_.max_batch && trace_[i + length] == first + length) {
+            ++length;
+        }
+
+        if (options_.fd >= 0) {
+            readahead(options_.fd, options_.file_offset + static_cast<off_t>(first * page_size_), length * page_size_);
+        } else {
+            madvise(base_ + first * page_size_, length * page_size_, MADV_WILLNEED);
+        }
+
+        i += length;
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        issued_.fetch_add(length, std::memory_order_release);
+    }
+}
+
+ReplayStats TraceReplay::stats() const
+{
+    ReplayStats stats;
+    stats.pages = trace_.size();
+    stats.issued = issued_.load(std::memory_order_acquire);
+    stats.calls = calls_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace prefetch
+} // namespace try_catch_guard
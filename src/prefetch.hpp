@@ -0,0 +1,133 @@
+#ifndef TRY_CATCH_GUARD_PREFETCH_HPP
+#define TRY_CATCH_GUARD_PREFETCH_HPP
+
+// Page-access recording and prefetch replay for faster cold starts.
+//
+// An AccessRecorder makes a mapping inaccessible (PROT_NONE) and logs the
+// order in which its pages are first touched: a range hook (see
+// addRangeFaultHook()) gives each page its protection back on the first
+// access, appends it to the trace and resumes the access. The trace is then
+// written to a file:
+//
+//   void* index = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+//   prefetch::AccessRecorder recorder(index, size);
+//   warmUp(index);                           // the startup walk
+//   recorder.writeTrace("index.pages");
+//
+// On later starts a TraceReplay issues madvise(MADV_WILLNEED), or
+// readahead() on the file, for the pages in that order from a background
+// thread, so the reads are already under way when the startup walk gets
+// there:
+//
+//   prefetch::TraceReplay replay("index.pages", index, size);
+//   replay.start();
+//   warmUp(index);
+//
+// Consecutive pages of the trace are coalesced into one call. A missing or
+// malformed trace loads as empty and start() then does nothing.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <vector>
+#include "try_catch_guard.hpp"
+
+namespace try_catch_guard {
+namespace prefetch {
+
+class AccessRecorder {
+public:
+    // Records the first touches of the mapping at `begin` (page aligned),
+    // `size` bytes rounded up to whole pages. Touched pages get `protection`
+    // back; stop() restores it on the others. Throws std::bad_alloc if the
+    // range hook cannot be set.
+    AccessRecorder(void* begin, std::size_t size, int protection = PROT_READ);
+    ~AccessRecorder();
+
+    AccessRecorder(const AccessRecorder&) = delete;
+    AccessRecorder& operator=(const AccessRecorder&) = delete;
+
+    // Stops recording and makes every page accessible again (idempotent)
+    void stop();
+
+    bool recording() const { return recording_; }
+
+    // Number of pages touched so far
+    std::size_t touchedPages() const { return count_.load(std::memory_order_acquire); }
+
+    // Page indices in the order of their first touch; call after stop()
+    std::vector<std::uint32_t> trace() const;
+
+    // Stops recording and writes the trace; returns false on an I/O error
+    bool writeTrace(const char* path);
+
+private:
+    static FaultAction onFault(void* context, int signal, siginfo_t* info, void* ucontext);
+
+    char* base_;
+    std::size_t page_size_;
+    std::size_t pages_;
+    int protection_;
+    bool recording_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> claimed_;  // First touch seen
+    std::unique_ptr<std::atomic<std::uint64_t>[]> restored_; // Protection given back
+    std::unique_ptr<std::uint32_t[]> order_;                  // One slot per page
+    std::atomic<std::size_t> count_;
+};
+
+// Reads a trace written by AccessRecorder::writeTrace(); returns an empty
+// trace if the file is missing or malformed
+std::vector<std::uint32_t> readTrace(const char* path);
+
+struct ReplayOptions {
+    int fd = -1;               // If set, readahead() on this file instead of madvise()
+    off_t file_offset = 0;     // Offset in the file of the start of the mapping
+    std::size_t max_batch = 64; // Consecutive pages coalesced into one call, at most
+};
+
+struct ReplayStats {
+    std::size_t pages = 0;  // Pages in the trace (inside the mapping)
+    std::size_t issued = 0; // Pages prefetched so far
+    std::size_t calls = 0;  // madvise()/readahead() calls so far
+};
+
+class TraceReplay {
+public:
+    // Loads the trace at `path` for the mapping at `begin` (page aligned),
+    // `size` bytes; pages outside of the mapping are dropped
+    TraceReplay(const char* path, void* begin, std::size_t size, const ReplayOptions& options = ReplayOptions());
+    ~TraceReplay(); // Waits for the background thread
+
+    TraceReplay(const TraceReplay&) = delete;
+    TraceReplay& operator=(const TraceReplay&) = delete;
+
+    bool loaded() const { return !trace_.empty(); }
+
+    // Starts prefetching from a background thread (once)
+    void start();
+
+    // Waits until every page of the trace was prefetched
+    void wait();
+
+    ReplayStats stats() const;
+
+private:
+    void run();
+
+    char* base_;
+    std::size_t page_size_;
+    ReplayOptions options_;
+    std::vector<std::uint32_t> trace_;
+    std::thread thread_;
+    std::atomic<std::size_t> issued_;
+    std::atomic<std::size_t> calls_;
+};
+
+} // namespace prefetch
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_PREFETCH_HPP
@@ -0,0 +1,496 @@
+// Guard-aware sampling profiler (see profiler.hpp).
+
+#include "profiler.hpp"
+#include "try_catch_guard.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+
+namespace try_catch_guard {
+namespace profiler {
+
+std::atomic<bool> profilerRunning(false);
+
+namespace {
+
+constexpr std::size_t maxGuards = 16;                 // Innermost guards placed per sample
+constexpr std::size_t maxEntries = maxDepth + maxGuards; // Frames plus guard markers
+constexpr std::uintptr_t guardMarker = 0;              // Entry of a guard in a stack
+constexpr std::size_t maxProbes = 64;
+
+// One distinct stack, root first. The slot is claimed by setting its hash;
+// `ready` is set once the frames are written.
+struct StackEntry {
+    std::atomic<std::uint64_t> hash{0};
+    std::atomic<bool> ready{false};
+    std::atomic<std::uint64_t> count{0};
+    std::uint32_t length = 0;
+    std::uintptr_t frames[maxEntries];
+};
+
+struct Profiler {
+    ProfilerOptions options;
+    std::unique_ptr<StackEntry[]> table;
+    std::size_t capacity = 0;
+    std::size_t armed = 0;
+    bool handler_installed = false;
+
+    std::atomic<std::uint64_t> samples{0};
+    std::atomic<std::uint64_t> guarded_samples{0};
+    std::atomic<std::uint64_t> dropped_samples{0};
+    std::atomic<std::uint64_t> walk_faults{0};
+    std::atomic<std::uint64_t> stacks{0};
+    std::atomic<int> in_flight{0}; // Signal handlers between their two checks of profilerRunning
+};
+
+// Guarded by getHandlersMutex(), except the atomics and the table slots
+Profiler state;
+
+// Walks the frame records ([fp] = caller's fp, [fp + 8] = return address);
+// `fps`, if given, receives the frame pointer of the function each address
+// returns to
+std::size_t walk(std::uintptr_t fp, std::uintptr_t* pcs, std::uintptr_t* fps, std::size_t max, bool& faulted)
+{
+    std::size_t count = 0;
+    faulted = false;
+
+    while (count < max && fp != 0 && (fp & (sizeof(void*) - 1)) == 0)
+    {
+        std::uintptr_t record[2];
+        if (!safeRead(record, reinterpret_cast<const void*>(fp), sizeof(record)))
+        {
+            faulted = true;
+            break;
+        }
+        if (record[1] == 0) {
+            break;
+        }
+
+        pcs[count] = record[1];
+        if (fps) {
+            fps[count] = record[0];
+        }
+        ++count;
+
+        // The stack grows down, so callers' frames are at higher addresses
+        if (record[0] <= fp) {
+            break;
+        }
+        fp = record[0];
+    }
+    return count;
+}
+
+std::uint64_t hashFrames(const std::uintptr_t* frames, std::size_t length)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        hash ^= frames[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash | 1; // 0 marks an empty slot
+}
+
+bool recordStack(const std::uintptr_t* frames, std::size_t length)
+{
+    std::uint64_t hash = hashFrames(frames, length);
+    std::size_t capacity = state.capacity;
+
+    for (std::size_t probe = 0; probe < maxProbes && probe < capacity; ++probe)
+    {
+        StackEntry& entry = state.table[(hash + probe) % capacity];
+        std::uint64_t current = entry.hash.load(std::memory_order_acquire);
+        if (current == 0)
+        {
+            if (entry.hash.compare_exchange_strong(current, hash, std::memory_order_acq_rel))
+            {
+                std::memcpy(entry.frames, frames, length * sizeof(std::uintptr_t));
+                entry.length = static_cast<std::uint32_t>(length);
+                entry.ready.store(true, std::memory_order_release);
+                entry.count.fetch_add(1, std::memory_order_relaxed);
+                state.stacks.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // Claimed meanwhile; `current` now holds its hash
+        }
+        if (current == hash)
+        {
+            entry.count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void takeSample(ThreadContext& thread, const ucontext_t* context)
+{
+#if defined(__x86_64__)
+    std::uintptr_t pc = static_cast<std::uintptr_t>(context->uc_mcontext.gregs[REG_RIP]);
+    std::uintptr_t fp = static_cast<std::uintptr_t>(context->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+    std::uintptr_t pc = static_cast<std::uintptr_t>(context->uc_mcontext.pc);
+    std::uintptr_t fp = static_cast<std::uintptr_t>(context->uc_mcontext.regs[29]);
+#else
+    std::uintptr_t pc = 0;
+    std::uintptr_t fp = 0;
+    (void)context;
+#endif
+
+    // Guards of the thread, innermost first; taken before the walk, whose
+    // reads push and pop guards of their own
+    std::uintptr_t guards[maxGuards];
+    std::size_t guard_count = 0;
+    for (JumpBufferStack::Frame* frame = thread.jmpbuf_stack.topFrame(); frame && guard_count < maxGuards;
+         frame = frame->previous) {
+        guards[guard_count++] = reinterpret_cast<std::uintptr_t>(frame);
+    }
+
+    // Function 0 is the interrupted one; function k + 1 is the caller of k.
+    // Each function's frame lies below its frame pointer.
+    std::uintptr_t pcs[maxDepth + 1];
+    std::uintptr_t fps[maxDepth + 1];
+    pcs[0] = pc;
+    fps[0] = fp;
+    bool faulted = false;
+    std::size_t depth = state.options.max_depth < maxDepth ? state.options.max_depth : maxDepth;
+    std::size_t functions = 1 + walk(fp, pcs + 1, fps + 1, depth > 0 ? depth - 1 : 0, faulted);
+    for (std::size_t k = 1; k < functions; ++k) {
+        pcs[k] -= 1; // Return address to the call instruction
+    }
+
+    // A guard belongs to the innermost function whose frame pointer is above it
+    std::size_t owner[maxGuards];
+    for (std::size_t g = 0; g < guard_count; ++g)
+    {
+        owner[g] = functions; // Beyond the walked frames: placed at the root
+        for (std::size_t k = 0; k < functions; ++k)
+        {
+            if (guards[g] <= fps[k])
+            {
+                owner[g] = k;
+                break;
+            }
+        }
+    }
+
+    // Root first; the guards of a function follow it
+    std::uintptr_t frames[maxEntries + 1];
+    std::size_t length = 0;
+    for (std::size_t g = guard_count; g-- > 0;)
+    {
+        if (owner[g] == functions) {
+            frames[length++] = guardMarker;
+        }
+    }
+    for (std::size_t k = functions; k-- > 0 && length < maxEntries;)
+    {
+        frames[length++] = pcs[k];
+        for (std::size_t g = guard_count; g-- > 0 && length < maxEntries;)
+        {
+            if (owner[g] == k) {
+                frames[length++] = guardMarker;
+            }
+        }
+    }
+
+    state.samples.fetch_add(1, std::memory_order_relaxed);
+    if (guard_count > 0) {
+        state.guarded_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (faulted) {
+        state.walk_faults.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!recordStack(frames, length)) {
+        state.dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void profilerSignalHandler(int, siginfo_t*, void* context)
+{
+    ThreadContext* thread = currentThreadContext;
+    if (!thread || !profilerRunning.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    int saved_errno = errno;
+    // A fault during the walk must not replace the address of a fault the
+    // thread is about to report
+    void* fault_address = currentFaultAddress;
+
+    state.in_flight.fetch_add(1, std::memory_order_seq_cst);
+    if (profilerRunning.load(std::memory_order_seq_cst)) {
+        takeSample(*thread, static_cast<const ucontext_t*>(context));
+    }
+    state.in_flight.fetch_sub(1, std::memory_order_seq_cst);
+
+    currentFaultAddress = fault_address;
+    errno = saved_errno;
+}
+
+// The CPU-time clock of a thread of this process, as the kernel encodes it
+// (what pthread_getcpuclockid() returns), built from its kernel thread id
+clockid_t threadCpuClock(int thread_id)
+{
+    return static_cast<clockid_t>((~static_cast<unsigned>(thread_id) << 3) | 6u);
+}
+
+std::string symbolize(std::uintptr_t pc)
+{
+    char buffer[64];
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(pc), &info) == 0 || !info.dli_fname)
+    {
+        std::snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(pc));
+        return buffer;
+    }
+
+    std::string name;
+    if (info.dli_sname)
+    {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        name = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+    }
+    else
+    {
+        const char* module = std::strrchr(info.dli_fname, '/');
+        std::snprintf(buffer, sizeof(buffer), "+0x%llx",
+                      static_cast<unsigned long long>(pc - reinterpret_cast<std::uintptr_t>(info.dli_fbase)));
+        name = std::string(module ? module + 1 : info.dli_fname) + buffer;
+    }
+
+    // ';' separates frames in the collapsed format
+    for (char& c : name)
+    {
+        if (c == ';') {
+            c = ':';
+        }
+    }
+    return name;
+}
+
+} // namespace
+
+void armThread(ThreadContext& context)
+{
+    sigevent event;
+    std::memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+#ifdef sigev_notify_thread_id
+    event.sigev_notify_thread_id = context.thread_id;
+#else
+    event._sigev_un._tid = context.thread_id; // glibc before 2.35 does not name the field
+#endif
+
+    timer_t timer;
+    if (timer_create(threadCpuClock(context.thread_id), &event, &timer) != 0) {
+        return;
+    }
+
+    unsigned frequency = state.options.frequency ? state.options.frequency : 1;
+    long period = 1000000000L / static_cast<long>(frequency);
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = period / 1000000000L;
+    spec.it_interval.tv_nsec = period % 1000000000L;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(timer, 0, &spec, nullptr) != 0)
+    {
+        timer_delete(timer);
+        return;
+    }
+
+    static_assert(sizeof(timer_t) <= sizeof(context.profiler_timer), "timer_t must fit in the thread context");
+    std::memcpy(&context.profiler_timer, &timer, sizeof(timer));
+    context.profiler_armed = true;
+    ++state.armed;
+}
+
+void disarmThread(ThreadContext& context)
+{
+    timer_t timer;
+    std::memcpy(&timer, &context.profiler_timer, sizeof(timer));
+    timer_delete(timer);
+    context.profiler_timer = nullptr;
+    context.profiler_armed = false;
+    --state.armed;
+}
+
+bool start(const ProfilerOptions& options)
+{
+    // The calling thread is profiled too
+    attachCurrentThread();
+
+    std::lock_guard<std::mutex> lock(getHandlersMutex());
+    if (profilerRunning.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // No handler uses the table once stop() returned
+    state.capacity = options.max_stacks ? options.max_stacks : 1;
+    state.table.reset(new (std::nothrow) StackEntry[state.capacity]);
+    if (!state.table)
+    {
+        state.capacity = 0;
+        return false;
+    }
+    state.options = options;
+    state.samples.store(0, std::memory_order_relaxed);
+    state.guarded_samples.store(0, std::memory_order_relaxed);
+    state.dropped_samples.store(0, std::memory_order_relaxed);
+    state.walk_faults.store(0, std::memory_order_relaxed);
+    state.stacks.store(0, std::memory_order_relaxed);
+
+    if (!state.handler_installed)
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = profilerSignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) != 0) {
+            return false;
+        }
+        state.handler_installed = true;
+    }
+
+    profilerRunning.store(true, std::memory_order_seq_cst);
+
+    std::size_t threads = 0;
+    for (ThreadContext* context = getThreadRegistry().head; context; context = context->registry_next)
+    {
+        armThread(*context);
+        ++threads;
+    }
+
+    if (state.armed != threads)
+    {
+        profilerRunning.store(false, std::memory_order_seq_cst);
+        for (ThreadContext* context = getThreadRegistry().head; context; context = context->registry_next)
+        {
+            if (context->profiler_armed) {
+                disarmThread(*context);
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+void stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(getHandlersMutex());
+        if (!profilerRunning.load(std::memory_order_relaxed)) {
+            return;
+        }
+        profilerRunning.store(false, std::memory_order_seq_cst);
+
+        for (ThreadContext* context = getThreadRegistry().head; context; context = context->registry_next)
+        {
+            if (context->profiler_armed) {
+                disarmThread(*context);
+            }
+        }
+    }
+
+    while (state.in_flight.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool isRunning()
+{
+    return profilerRunning.load(std::memory_order_relaxed);
+}
+
+ProfilerStats getStats()
+{
+    ProfilerStats stats;
+    stats.samples = state.samples.load(std::memory_order_relaxed);
+    stats.guarded_samples = state.guarded_samples.load(std::memory_order_relaxed);
+    stats.dropped_samples = state.dropped_samples.load(std::memory_order_relaxed);
+    stats.walk_faults = state.walk_faults.load(std::memory_order_relaxed);
+    stats.stacks = state.stacks.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(getHandlersMutex());
+        stats.armed_threads = state.armed;
+    }
+    return stats;
+}
+
+std::string collapsedStacks()
+{
+    std::lock_guard<std::mutex> lock(getHandlersMutex());
+
+    // Stacks that differ only in return addresses within the same functions merge
+    std::map<std::uintptr_t, std::string> names;
+    std::map<std::string, std::uint64_t> lines;
+    for (std::size_t i = 0; i < state.capacity; ++i)
+    {
+        StackEntry& entry = state.table[i];
+        if (!entry.ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        std::string line;
+        for (std::uint32_t f = 0; f < entry.length; ++f)
+        {
+            if (f > 0) {
+                line += ';';
+            }
+            std::uintptr_t pc = entry.frames[f];
+            if (pc == guardMarker)
+            {
+                line += "[guard]";
+                continue;
+            }
+            auto name = names.find(pc);
+            if (name == names.end()) {
+                name = names.emplace(pc, symbolize(pc)).first;
+            }
+            line += name->second;
+        }
+        lines[line] += entry.count.load(std::memory_order_relaxed);
+    }
+
+    std::string output;
+    for (const auto& line : lines) {
+        output += line.first + " " + std::to_string(line.second) + "\n";
+    }
+    return output;
+}
+
+bool writeCollapsed(const char* path)
+{
+    std::string output = collapsedStacks();
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(output.data(), 1, output.size(), file) == output.size();
+    return std::fclose(file) == 0 && written;
+}
+
+std::size_t walkFramePointers(const void* frame_pointer, std::uintptr_t* pcs, std::size_t max)
+{
+    bool faulted = false;
+    return walk(reinterpret_cast<std::uintptr_t>(frame_pointer), pcs, nullptr, max, faulted);
+}
+
+} // namespace profiler
+} // namespace try_catch_guard
@@ -0,0 +1,91 @@
+#ifndef TRY_CATCH_GUARD_PROFILER_HPP
+#define TRY_CATCH_GUARD_PROFILER_HPP
+
+// Guard-aware sampling profiler.
+//
+// start() arms a SIGPROF timer on the CPU-time clock of every registered
+// thread (and of every thread registered while it runs). Each sample records
+// a frame-pointer backtrace of the interrupted code together with the guards
+// active on the thread: a "[guard]" frame is inserted after the function
+// whose stack frame holds the guard, so time spent inside guarded regions
+// shows up under it in a flame graph.
+//
+//   profiler::start();
+//   ...
+//   profiler::stop();
+//   profiler::writeCollapsed("profile.folded"); // flamegraph.pl profile.folded > profile.svg
+//
+// The backtrace is read with safeRead(), so a corrupt frame pointer ends the
+// walk instead of crashing: the SIGSEGV handler recovers the read like any
+// other guarded fault (and counts it in getRecoveredFaultCount()). Only code
+// built with frame pointers (-fno-omit-frame-pointer) can be walked past;
+// x86-64 and AArch64 are supported.
+//
+// Samples are merged in the signal handler into a fixed table of distinct
+// stacks allocated by start(); samples of new stacks that do not fit are
+// counted as dropped. Functions are named with dladdr() when the output is
+// written, so symbols of the executable need -rdynamic; others are written as
+// module+offset.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace try_catch_guard {
+
+struct ThreadContext;
+
+namespace profiler {
+
+constexpr unsigned maxDepth = 64; // Frames walked per sample
+
+struct ProfilerOptions {
+    unsigned frequency = 997;      // Samples per second of thread CPU time
+    std::size_t max_stacks = 4096; // Distinct stacks kept
+    unsigned max_depth = maxDepth; // Frames walked per sample (at most maxDepth)
+};
+
+struct ProfilerStats {
+    std::uint64_t samples = 0;         // Samples taken
+    std::uint64_t guarded_samples = 0; // Samples taken inside at least one guard
+    std::uint64_t dropped_samples = 0; // Samples of new stacks that did not fit in the table
+    std::uint64_t walk_faults = 0;     // Stack walks ended by a fault on a bad frame pointer
+    std::uint64_t stacks = 0;          // Distinct stacks recorded
+    std::size_t armed_threads = 0;     // Threads with a running timer
+};
+
+// Starts sampling; clears the previous profile. Returns false if the
+// profiler is already running or the table or a timer cannot be created.
+bool start(const ProfilerOptions& options = ProfilerOptions());
+
+// Stops sampling and waits for samples in flight; the profile is kept. The
+// SIGPROF handler stays installed, so a late timer signal is ignored.
+void stop();
+
+bool isRunning();
+
+ProfilerStats getStats();
+
+// The profile in collapsed-stack format: one line per distinct stack, frames
+// from the root separated by ';', then a space and the number of samples
+std::string collapsedStacks();
+
+// Writes collapsedStacks() to `path`; returns false on an I/O error
+bool writeCollapsed(const char* path);
+
+// Walks the frame-pointer chain starting at `frame_pointer` and stores up to
+// `max` return addresses in `pcs`. Every read goes through safeRead(); the
+// walk stops at a null, misaligned or non-increasing frame pointer or at an
+// unreadable frame. Returns the number of addresses stored.
+std::size_t walkFramePointers(const void* frame_pointer, std::uintptr_t* pcs, std::size_t max);
+
+// Used by the thread registry; the caller holds getHandlersMutex()
+extern std::atomic<bool> profilerRunning;
+void armThread(ThreadContext& context);
+void disarmThread(ThreadContext& context);
+
+} // namespace profiler
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_PROFILER_HPP
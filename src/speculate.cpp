@@ -0,0 +1,232 @@
+// Speculation sites (see speculate.hpp).
+
+#include "speculate.hpp"
+
+#include <cstring>
+#include <mutex>
+
+namespace try_catch_guard {
+namespace speculation {
+
+struct SiteAccess {
+    static std::atomic<std::uint64_t>& attempts(Site& site) { return site.attempts_; }
+    static std::atomic<std::uint64_t>& faults(Site& site) { return site.faults_; }
+    static std::atomic<std::uint64_t>& slowRuns(Site& site) { return site.slow_runs_; }
+    static Site*& next(Site& site) { return site.next_; }
+
+    static std::atomic<std::uint64_t>& faults(AdaptiveSite& site) { return site.faults_; }
+    static std::atomic<std::uint64_t>& rejections(AdaptiveSite& site) { return site.rejections_; }
+    static std::atomic<std::uint64_t>& switches(AdaptiveSite& site) { return site.switches_; }
+    static AdaptiveSite*& next(AdaptiveSite& site) { return site.next_; }
+};
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    Site* sites = nullptr;
+    AdaptiveSite* adaptive_sites = nullptr;
+};
+
+std::uint32_t fixedRate(double rate)
+{
+    if (rate <= 0.0) {
+        return 0;
+    }
+    if (rate >= 1.0) {
+        return AdaptiveSite::rateOne;
+    }
+    return static_cast<std::uint32_t>(rate * AdaptiveSite::rateOne);
+}
+
+// Removes `site` from an intrusive list; caller holds the mutex
+template <typename SiteType>
+void unlinkSite(SiteType*& head, SiteType* site)
+{
+    for (SiteType** link = &head; *link; link = &SiteAccess::next(**link))
+    {
+        if (*link == site)
+        {
+            *link = SiteAccess::next(*site);
+            break;
+        }
+    }
+}
+
+Registry& getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+} // namespace
+
+Site::Site(const char* name, const PinPolicy& policy)
+    : name_(name), policy_(policy), pinned_(false), attempts_(0), faults_(0), slow_runs_(0), next_(nullptr)
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    next_ = registry.sites;
+    registry.sites = this;
+}
+
+Site::~Site()
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    unlinkSite(registry.sites, this);
+}
+
+void Site::recordFault()
+{
+    std::uint64_t attempts = attempts_.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::uint64_t faults = faults_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (attempts >= policy_.min_attempts &&
+        static_cast<double>(faults) > policy_.max_fault_ratio * static_cast<double>(attempts)) {
+        pinned_.store(true, std::memory_order_relaxed);
+    }
+}
+
+void Site::reset()
+{
+    pinned_.store(false, std::memory_order_relaxed);
+    attempts_.store(0, std::memory_order_relaxed);
+    faults_.store(0, std::memory_order_relaxed);
+    slow_runs_.store(0, std::memory_order_relaxed);
+}
+
+std::vector<SiteStats> siteStats()
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<SiteStats> stats;
+    for (Site* site = registry.sites; site; site = SiteAccess::next(*site))
+    {
+        SiteStats entry;
+        entry.name = site->name();
+        entry.attempts = SiteAccess::attempts(*site).load(std::memory_order_relaxed);
+        entry.faults = SiteAccess::faults(*site).load(std::memory_order_relaxed);
+        entry.slow_runs = SiteAccess::slowRuns(*site).load(std::memory_order_relaxed);
+        entry.pinned = site->pinned();
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+bool unpinSite(const char* name)
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    bool found = false;
+    for (Site* site = registry.sites; site; site = SiteAccess::next(*site))
+    {
+        if (std::strcmp(site->name(), name) == 0)
+        {
+            site->reset();
+            found = true;
+        }
+    }
+    return found;
+}
+
+AdaptiveSite::AdaptiveSite(const char* name, const AdaptivePolicy& policy)
+    : name_(name),
+      shift_(policy.decay_shift),
+      enter_(fixedRate(policy.enter_validation)),
+      leave_(fixedRate(policy.leave_validation)),
+      validating_(false),
+      rate_(0),
+      faults_(0),
+      rejections_(0),
+      switches_(0),
+      next_(nullptr)
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    next_ = registry.adaptive_sites;
+    registry.adaptive_sites = this;
+}
+
+AdaptiveSite::~AdaptiveSite()
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    unlinkSite(registry.adaptive_sites, this);
+}
+
+// The rate moves 1/2^shift of the way towards 0 (success) or 1 (fault). The
+// updates are a relaxed load and store: concurrent calls may lose an update,
+// which only delays a switch. The strategy is only re-evaluated here, so
+// choosing it on the next call is a single load.
+void AdaptiveSite::decay(std::uint32_t rate)
+{
+    std::uint32_t step = (rate + (1u << shift_) - 1) >> shift_; // Rounded up, so the rate reaches 0
+    rate -= step;
+    rate_.store(rate, std::memory_order_relaxed);
+
+    if (rate < leave_ && validating_.load(std::memory_order_relaxed))
+    {
+        validating_.store(false, std::memory_order_relaxed);
+        switches_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AdaptiveSite::raise()
+{
+    std::uint32_t rate = rate_.load(std::memory_order_relaxed);
+    rate += (rateOne - rate) >> shift_;
+    rate_.store(rate, std::memory_order_relaxed);
+
+    if (rate > enter_ && !validating_.load(std::memory_order_relaxed))
+    {
+        validating_.store(true, std::memory_order_relaxed);
+        switches_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AdaptiveSite::recordFault()
+{
+    faults_.fetch_add(1, std::memory_order_relaxed);
+    raise();
+}
+
+void AdaptiveSite::recordRejection()
+{
+    rejections_.fetch_add(1, std::memory_order_relaxed);
+    raise();
+}
+
+void AdaptiveSite::reset()
+{
+    validating_.store(false, std::memory_order_relaxed);
+    rate_.store(0, std::memory_order_relaxed);
+    faults_.store(0, std::memory_order_relaxed);
+    rejections_.store(0, std::memory_order_relaxed);
+    switches_.store(0, std::memory_order_relaxed);
+}
+
+std::vector<AdaptiveSiteStats> adaptiveSiteStats()
+{
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<AdaptiveSiteStats> stats;
+    for (AdaptiveSite* site = registry.adaptive_sites; site; site = SiteAccess::next(*site))
+    {
+        AdaptiveSiteStats entry;
+        entry.name = site->name();
+        entry.fault_rate = site->faultRate();
+        entry.validating = site->validating();
+        entry.faults = SiteAccess::faults(*site).load(std::memory_order_relaxed);
+        entry.rejections = SiteAccess::rejections(*site).load(std::memory_order_relaxed);
+        entry.switches = SiteAccess::switches(*site).load(std::memory_order_relaxed);
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+} // namespace speculation
+} // namespace try_catch_guard
@@ -0,0 +1,298 @@
+#ifndef TRY_CATCH_GUARD_SPECULATE_HPP
+#define TRY_CATCH_GUARD_SPECULATE_HPP
+
+// Speculate-then-fallback on top of the guard.
+//
+// speculate(fast, slow) runs `fast`, an implementation that trusts its input
+// (no null or bounds checks), under a guard that returns instead of throwing.
+// If it faults, whatever it was computing is discarded and `slow`, the
+// validating implementation, runs instead:
+//
+//   Totals totals = speculate([&] { return parseUnchecked(data); },
+//                             [&] { return parseChecked(data, size); });
+//
+// The result of `fast` is only used when it returns normally, so its partial
+// output is never seen. Anything `fast` writes outside of its result is not
+// rolled back, and destructors of objects it created are skipped on a fault
+// (as for any guarded block); keep it free of side effects and ownership.
+// C++ exceptions thrown by `fast` propagate and do not count as faults.
+//
+// Every call site keeps counters. A site whose speculations keep faulting
+// (more than max_fault_ratio of them, after min_attempts) is pinned to the
+// slow path: from then on `slow` runs directly, at the cost of one load.
+// unpinSite() (or Site::reset()) starts the site over, e.g. after the input
+// changed. The two-argument form keys the site on the type of `fast`; give a
+// named Site to see it in siteStats():
+//
+//   static speculation::Site site("parser.records");
+//   speculation::speculate(site, fast, slow);
+//
+// adaptive(site, validate, block, invalid) switches back and forth instead of
+// pinning. While the decayed fault rate of the site is low, `block` runs
+// under the guard (execute and catch); once the rate crosses
+// enter_validation, `validate` probes the input first and `block` runs
+// without a guard, until the rate falls below leave_validation. Inputs
+// rejected by `validate` count as faults, so the rate keeps being measured
+// in both modes. `invalid` provides the result of a faulted or rejected call:
+//
+//   static speculation::AdaptiveSite site("parser.record");
+//   bool valid = speculation::adaptive(site,
+//       [&] { return recordInBounds(data, size, i); },
+//       [&] { return parseRecordUnchecked(data, i); },
+//       [] { return false; });
+//
+// `validate` must only accept inputs on which `block` cannot fault.
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "try_catch_guard.hpp"
+
+namespace try_catch_guard {
+namespace speculation {
+
+// When a site is pinned to its slow path
+struct PinPolicy {
+    std::uint64_t min_attempts = 32; // Speculations before the fault ratio is considered
+    double max_fault_ratio = 0.05;   // Pin once faults exceed this fraction of the speculations
+};
+
+// Counters of a speculation site; registered while it exists
+class Site {
+public:
+    explicit Site(const char* name, const PinPolicy& policy = PinPolicy());
+    ~Site();
+
+    Site(const Site&) = delete;
+    Site& operator=(const Site&) = delete;
+
+    const char* name() const { return name_; }
+
+    bool pinned() const { return pinned_.load(std::memory_order_relaxed); }
+
+    void recordSuccess() { attempts_.fetch_add(1, std::memory_order_relaxed); }
+    void recordSlowRun() { slow_runs_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Counts a faulted speculation and pins the site if the policy says so
+    void recordFault();
+
+    // Clears the counters and unpins the site
+    void reset();
+
+private:
+    friend struct SiteAccess;
+
+    const char* name_;
+    PinPolicy policy_;
+    std::atomic<bool> pinned_;
+    std::atomic<std::uint64_t> attempts_;
+    std::atomic<std::uint64_t> faults_;
+    std::atomic<std::uint64_t> slow_runs_;
+    Site* next_;
+};
+
+// Thresholds of an adaptive site, as fault rates between 0 and 1
+struct AdaptivePolicy {
+    unsigned decay_shift = 6;       // Each outcome weighs 1/2^decay_shift (about the last 64 calls)
+    double enter_validation = 0.05; // Switch to validation above this rate
+    double leave_validation = 0.01; // Switch back to execute-and-catch below this rate
+};
+
+// Decayed fault rate and current strategy of an adaptive site; registered
+// while it exists
+class AdaptiveSite {
+public:
+    static constexpr std::uint32_t rateOne = 1u << 16; // Fixed-point rate of 1.0
+
+    explicit AdaptiveSite(const char* name, const AdaptivePolicy& policy = AdaptivePolicy());
+    ~AdaptiveSite();
+
+    AdaptiveSite(const AdaptiveSite&) = delete;
+    AdaptiveSite& operator=(const AdaptiveSite&) = delete;
+
+    const char* name() const { return name_; }
+
+    bool validating() const { return validating_.load(std::memory_order_relaxed); }
+
+    double faultRate() const
+    {
+        return static_cast<double>(rate_.load(std::memory_order_relaxed)) / rateOne;
+    }
+
+    // A call that neither faulted nor was rejected; free once the rate is zero
+    void recordSuccess()
+    {
+        std::uint32_t rate = rate_.load(std::memory_order_relaxed);
+        if (__builtin_expect(rate != 0, 0)) {
+            decay(rate);
+        }
+    }
+
+    void recordFault();
+    void recordRejection();
+
+    // Clears the rate and counters and goes back to execute-and-catch
+    void reset();
+
+private:
+    friend struct SiteAccess;
+
+    void decay(std::uint32_t rate);
+    void raise();
+
+    const char* name_;
+    unsigned shift_;
+    std::uint32_t enter_; // Fixed-point thresholds
+    std::uint32_t leave_;
+    std::atomic<bool> validating_;
+    std::atomic<std::uint32_t> rate_;
+    std::atomic<std::uint64_t> faults_;
+    std::atomic<std::uint64_t> rejections_;
+    std::atomic<std::uint64_t> switches_;
+    AdaptiveSite* next_;
+};
+
+struct SiteStats {
+    std::string name;
+    std::uint64_t attempts = 0;  // Speculations (fast path runs)
+    std::uint64_t faults = 0;    // Speculations that faulted
+    std::uint64_t slow_runs = 0; // Slow path runs, after a fault or while pinned
+    bool pinned = false;
+};
+
+// Counters of every existing site
+std::vector<SiteStats> siteStats();
+
+// Resets every site named `name`; returns false if there is none
+bool unpinSite(const char* name);
+
+struct AdaptiveSiteStats {
+    std::string name;
+    double fault_rate = 0.0;      // Decayed rate of faults and rejections
+    bool validating = false;      // Current strategy
+    std::uint64_t faults = 0;     // Faults caught while executing unvalidated
+    std::uint64_t rejections = 0; // Inputs rejected by validation
+    std::uint64_t switches = 0;   // Strategy changes
+};
+
+// Counters of every existing adaptive site
+std::vector<AdaptiveSiteStats> adaptiveSiteStats();
+
+namespace detail {
+
+using SpeculationGuard = basic_guard<policy::result_on_fault>;
+
+// Site of the two-argument speculate(), one per type of fast path
+template <typename Fast>
+Site& implicitSite()
+{
+    static Site site(typeid(Fast).name());
+    return site;
+}
+
+} // namespace detail
+
+// Runs `fast` under a guard and falls back to `slow` if it faults or if the
+// site is pinned. Both must return the same type (or void).
+template <typename Fast, typename Slow>
+auto speculate(Site& site, Fast&& fast, Slow&& slow) -> decltype(slow())
+{
+    using Result = decltype(slow());
+
+    if (__builtin_expect(site.pinned(), 0))
+    {
+        site.recordSlowRun();
+        return slow();
+    }
+
+    if constexpr (std::is_void<Result>::value)
+    {
+        GuardResult guard = detail::SpeculationGuard::run([&] { fast(); });
+        if (__builtin_expect(!guard.faulted(), 1))
+        {
+            site.recordSuccess();
+            return;
+        }
+        site.recordFault();
+        site.recordSlowRun();
+        slow();
+    }
+    else
+    {
+        std::optional<Result> value;
+        GuardResult guard = detail::SpeculationGuard::run([&] { value.emplace(fast()); });
+        if (__builtin_expect(!guard.faulted(), 1))
+        {
+            site.recordSuccess();
+            return std::move(*value);
+        }
+        site.recordFault();
+        site.recordSlowRun();
+        return slow();
+    }
+}
+
+template <typename Fast, typename Slow>
+auto speculate(Fast&& fast, Slow&& slow) -> decltype(slow())
+{
+    return speculate(detail::implicitSite<typename std::decay<Fast>::type>(),
+                     std::forward<Fast>(fast), std::forward<Slow>(slow));
+}
+
+// Runs `block` under a guard, or after `validate` without one, depending on
+// the fault rate of the site; returns invalid() if the call faulted or was
+// rejected. `block` and `invalid` must return the same type (or void).
+template <typename Validate, typename Block, typename Invalid>
+auto adaptive(AdaptiveSite& site, Validate&& validate, Block&& block, Invalid&& invalid) -> decltype(invalid())
+{
+    using Result = decltype(invalid());
+
+    if (__builtin_expect(site.validating(), 0))
+    {
+        if (!validate())
+        {
+            site.recordRejection();
+            return invalid();
+        }
+        site.recordSuccess();
+        return block();
+    }
+
+    if constexpr (std::is_void<Result>::value)
+    {
+        GuardResult guard = detail::SpeculationGuard::run([&] { block(); });
+        if (__builtin_expect(!guard.faulted(), 1))
+        {
+            site.recordSuccess();
+            return;
+        }
+        site.recordFault();
+        invalid();
+    }
+    else
+    {
+        std::optional<Result> value;
+        GuardResult guard = detail::SpeculationGuard::run([&] { value.emplace(block()); });
+        if (__builtin_expect(!guard.faulted(), 1))
+        {
+            site.recordSuccess();
+            return std::move(*value);
+        }
+        site.recordFault();
+        return invalid();
+    }
+}
+
+} // namespace speculation
+
+using speculation::speculate;
+using speculation::adaptive;
+
+} // namespace try_catch_guard
+
+#endif // TRY_CATCH_GUARD_SPECULATE_HPP
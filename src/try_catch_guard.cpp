@@ -0,0 +1,809 @@
+// Out-of-line part of the TryCatchGuard library.
+//
+// Everything that must exist exactly once per process lives here: the
+// thread-local context, the thread registry and the signal handlers. The
+// header only keeps the inline fast path of segvTryBlock, so guards entered
+// from different translation units or shared objects share one jump buffer
+// stack per thread and nest correctly.
+
+#include "try_catch_guard.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <typeinfo>
+#include <cxxabi.h>
+#include <unwind.h>
+
+// Code that runs while a fault is recovered is placed in its own section, so
+// the low-jitter mode can lock it by range (__start_/__stop_ are provided by
+// the linker for sections named like C identifiers)
+#define TRY_CATCH_GUARD_FAULT_PATH __attribute__((section("tcg_fault_path")))
+
+extern "C" char __start_tcg_fault_path[];
+extern "C" char __stop_tcg_fault_path[];
+
+#if TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+// x86-64 context backend (see context_capture.hpp). The capture saves the
+// callee-saved registers, the caller's stack pointer and the return address;
+// the resume restores them and returns `value` (1 if 0) from the capture.
+__asm__(
+    ".pushsection tcg_fault_path, \"ax\", @progbits\n"
+    ".globl tcg_asm_context_capture\n"
+    ".type tcg_asm_context_capture, @function\n"
+    "tcg_asm_context_capture:\n"
+    "    movq %rbx, 0(%rdi)\n"
+    "    movq %rbp, 8(%rdi)\n"
+    "    movq %r12, 16(%rdi)\n"
+    "    movq %r13, 24(%rdi)\n"
+    "    movq %r14, 32(%rdi)\n"
+    "    movq %r15, 40(%rdi)\n"
+    "    leaq 8(%rsp), %rdx\n"
+    "    movq %rdx, 48(%rdi)\n"
+    "    movq (%rsp), %rdx\n"
+    "    movq %rdx, 56(%rdi)\n"
+    "    xorl %eax, %eax\n"
+    "    ret\n"
+    ".size tcg_asm_context_capture, .-tcg_asm_context_capture\n"
+    ".globl tcg_asm_context_resume\n"
+    ".type tcg_asm_context_resume, @function\n"
+    "tcg_asm_context_resume:\n"
+    "    movl $1, %eax\n"
+    "    testl %esi, %esi\n"
+    "    cmovnel %esi, %eax\n"
+    "    movq 0(%rdi), %rbx\n"
+    "    movq 8(%rdi), %rbp\n"
+    "    movq 16(%rdi), %r12\n"
+    "    movq 24(%rdi), %r13\n"
+    "    movq 32(%rdi), %r14\n"
+    "    movq 40(%rdi), %r15\n"
+    "    movq 48(%rdi), %rsp\n"
+    "    jmpq *56(%rdi)\n"
+    ".size tcg_asm_context_resume, .-tcg_asm_context_resume\n"
+    ".popsection\n");
+#endif
+
+namespace try_catch_guard {
+
+TRY_CATCH_GUARD_TLS ThreadContext* currentThreadContext = nullptr;
+TRY_CATCH_GUARD_TLS void* currentFaultAddress = nullptr;
+
+namespace {
+
+// The context of the current thread; currentThreadContext points to it
+// while the thread is registered
+thread_local ThreadContext threadContextStorage;
+
+// Bytes of all undo logs (see allocateUndoLog()), reported by getMemoryFootprint()
+std::atomic<std::size_t> undoLogBytes(0);
+
+// Set when threadContextStorage was destroyed at thread exit. A guard entered
+// afterwards (from a later thread_local destructor) attaches the context again
+// without linking it into the registry, which would keep it past the thread.
+TRY_CATCH_GUARD_TLS bool threadContextDestroyed = false;
+
+// Everything freed is reset, so a guard entered by a thread_local destructor
+// that runs later attaches again instead of using freed memory
+void releaseThreadResources(ThreadContext& context)
+{
+    context.exception_hold = nullptr;
+
+    if (context.exception_reserve)
+    {
+        abi::__cxa_free_exception(context.exception_reserve);
+        context.exception_reserve = nullptr;
+    }
+
+    if (context.undo_log)
+    {
+        undoLogBytes.fetch_sub(sizeof(UndoLog) + context.undo_log->capacity * sizeof(UndoLog::Entry),
+                               std::memory_order_relaxed);
+        delete[] context.undo_log->entries;
+        delete context.undo_log;
+        context.undo_log = nullptr;
+    }
+
+    if (context.alternate_stack)
+    {
+        stack_t disabled;
+        memset(&disabled, 0, sizeof(disabled));
+        disabled.ss_flags = SS_DISABLE;
+        sigaltstack(&disabled, nullptr);
+        munmap(context.alternate_stack, context.alternate_stack_size);
+        context.alternate_stack = nullptr;
+        context.alternate_stack_size = 0;
+    }
+}
+
+// Frees what guards entered after the context's destructor allocated. It is
+// a local thread_local, so its destructor is registered by the first late
+// attach, during the thread_local destructors, and still runs.
+struct LateContextRelease {
+    ~LateContextRelease()
+    {
+        releaseThreadResources(threadContextStorage);
+        currentThreadContext = nullptr;
+    }
+};
+
+void releaseLateAttach()
+{
+    static thread_local LateContextRelease release;
+    (void)release;
+}
+
+std::once_flag globalHandlerInstalled;
+
+// Signals whose handler installSignalHandler() has installed, and the
+// actions they replaced (for FaultAction::Chain)
+std::mutex installedSignalsMutex;
+std::uint64_t installedSignals = 0;
+struct sigaction previousActions[64];
+
+// Hands the signal to the action installed before the library's. The
+// default action is restored and, for a fault, happens when the faulting
+// instruction is retried; a signal sent with kill/raise is sent again.
+TRY_CATCH_GUARD_FAULT_PATH void chainSignal(int signal, siginfo_t* signalInfo, void* extra)
+{
+    const struct sigaction& previous = previousActions[signal];
+
+    if (previous.sa_flags & SA_SIGINFO)
+    {
+        if (previous.sa_sigaction) {
+            previous.sa_sigaction(signal, signalInfo, extra);
+        }
+        return;
+    }
+    if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+    {
+        previous.sa_handler(signal);
+        return;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signal, &sa, nullptr);
+
+    if (!signalInfo || signalInfo->si_code <= 0) {
+        raise(signal);
+    }
+}
+
+// Calls `hook`; FaultAction::Continue when there is none
+TRY_CATCH_GUARD_FAULT_PATH FaultAction runHook(const FaultHook& hook, int signal, siginfo_t* signalInfo, void* extra)
+{
+    return hook.handler ? hook.handler(hook.context, signal, signalInfo, extra) : FaultAction::Continue;
+}
+
+// Range hooks (addRangeFaultHook()). A slot is in use while `end` is not 0;
+// `hook` and `begin` are written before `end` is published. The handler
+// counts itself in rangeHooksInFlight while it scans, so a removal can wait
+// until no handler still sees the slot.
+struct RangeHookSlot {
+    std::atomic<std::uintptr_t> begin{0};
+    std::atomic<std::uintptr_t> end{0};
+    FaultHook hook;
+};
+
+RangeHookSlot rangeHooks[maxRangeFaultHooks];
+std::atomic<std::size_t> rangeHookLimit(0); // Slots at or above are unused
+std::atomic<unsigned> rangeHooksInFlight(0);
+std::mutex rangeHooksMutex;
+
+// Runs the range hook covering `address`; FaultAction::Continue when there is none
+TRY_CATCH_GUARD_FAULT_PATH FaultAction runRangeHook(void* address, int signal, siginfo_t* signalInfo, void* extra)
+{
+    std::size_t limit = rangeHookLimit.load(std::memory_order_acquire);
+    if (limit == 0 || address == nullptr) {
+        return FaultAction::Continue;
+    }
+
+    rangeHooksInFlight.fetch_add(1, std::memory_order_seq_cst);
+    FaultAction action = FaultAction::Continue;
+    std::uintptr_t value = reinterpret_cast<std::uintptr_t>(address);
+    for (std::size_t i = 0; i < limit; ++i)
+    {
+        const RangeHookSlot& slot = rangeHooks[i];
+        std::uintptr_t end = slot.end.load(std::memory_order_seq_cst);
+        if (value < end && value >= slot.begin.load(std::memory_order_relaxed))
+        {
+            action = runHook(slot.hook, signal, signalInfo, extra);
+            break;
+        }
+    }
+    rangeHooksInFlight.fetch_sub(1, std::memory_order_release);
+    return action;
+}
+
+// Incremented by the signal handler; lock-free, so safe to use there
+std::atomic<std::uint64_t> recoveredFaults(0);
+
+// Writes the message of the exception for a fault at `address` into `out`
+// without allocating (the fault may have happened inside the allocator)
+TRY_CATCH_GUARD_FAULT_PATH void formatFaultMessage(char (&out)[InvalidMemoryAccessException::messageCapacity], const void* address)
+{
+    static const char nullMessage[] = "Invalid null pointer access exception";
+    static const char prefix[] = "Invalid memory access exception at address (0x";
+    static_assert(sizeof(prefix) + 2 * sizeof(void*) + 1 <= InvalidMemoryAccessException::messageCapacity,
+                  "the fault message must fit in the exception");
+
+    if (address == nullptr)
+    {
+        memcpy(out, nullMessage, sizeof(nullMessage));
+        return;
+    }
+
+    memcpy(out, prefix, sizeof(prefix) - 1);
+    char* cursor = out + sizeof(prefix) - 1;
+
+    // Upper-case hexadecimal without leading zeros, like std::hex << std::uppercase
+    char digits[2 * sizeof(void*)];
+    std::size_t count = 0;
+    std::uintptr_t value = reinterpret_cast<std::uintptr_t>(address);
+    do {
+        digits[count++] = "0123456789ABCDEF"[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+    while (count > 0) {
+        *cursor++ = digits[--count];
+    }
+
+    *cursor++ = ')';
+    *cursor = '\0';
+}
+
+// Header that __cxa_allocate_exception() places before the thrown object: the
+// Itanium C++ ABI __cxa_exception preceded by the reference count of
+// libstdc++'s __cxa_refcounted_exception (only declared by <cxxabi.h>)
+struct AbiExceptionHeader {
+    std::size_t reference_count;
+    std::type_info* exception_type;
+    void (*exception_destructor)(void*);
+    void (*unexpected_handler)();
+    void (*terminate_handler)();
+    void* next_exception;
+    int handler_count;
+    int handler_switch_value;
+    const unsigned char* action_record;
+    const unsigned char* language_specific_data;
+    void* catch_temp;
+    void* adjusted_ptr;
+    _Unwind_Exception unwind_header;
+};
+
+TRY_CATCH_GUARD_FAULT_PATH void destroyReservedException(void* object)
+{
+    static_cast<InvalidMemoryAccessException*>(object)->~InvalidMemoryAccessException();
+}
+
+// Low-jitter mode (enableLowJitterMode()); the options are written once,
+// before lowJitterEnabled is set
+std::atomic<bool> lowJitterEnabled(false);
+LowJitterOptions lowJitterOptions;
+std::atomic<bool> lowJitterAllLocked(true);
+std::atomic<std::size_t> lowJitterLockedBytes(0);
+std::atomic<std::size_t> lowJitterLockedReserves(0);
+
+// Pre-touches the pages of [begin, begin + size) and, if requested, locks them;
+// returns true if they were locked. The touches read whole pages, outside of
+// the objects being pinned. Locked pages are counted in locked_bytes when
+// `counted`.
+__attribute__((no_sanitize("address"))) bool pinRange(const void* begin, std::size_t size, bool counted = true)
+{
+    if (size == 0) {
+        return false;
+    }
+
+    std::uintptr_t page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    std::uintptr_t first = reinterpret_cast<std::uintptr_t>(begin) & ~(page - 1);
+    std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(begin) + size + page - 1) & ~(page - 1);
+
+    for (std::uintptr_t address = first; address < last; address += page) {
+        (void)*reinterpret_cast<volatile const char*>(address);
+    }
+
+    if (lowJitterOptions.lock_memory)
+    {
+        if (mlock(reinterpret_cast<void*>(first), last - first) == 0)
+        {
+            if (counted) {
+                lowJitterLockedBytes.fetch_add(last - first, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        lowJitterAllLocked.store(false, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+// Pins an exception reserve with the header that precedes it. Every refill
+// allocates a new one; only the first of each thread is counted, so
+// locked_bytes does not grow with the number of recoveries.
+void pinExceptionReserve(void* reserve, bool counted)
+{
+    if (pinRange(static_cast<char*>(reserve) - sizeof(AbiExceptionHeader),
+                 sizeof(AbiExceptionHeader) + sizeof(InvalidMemoryAccessException), counted)) {
+        lowJitterLockedReserves.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Gives the calling thread its alternate signal stack and pins its state
+void prepareLowJitterThread(ThreadContext& context)
+{
+    std::size_t stack_size = lowJitterOptions.alternate_stack_size;
+    if (stack_size != 0 && !context.alternate_stack)
+    {
+        // Keep a large enough alternate stack the thread already has
+        stack_t current;
+        if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE) && current.ss_size >= stack_size)
+        {
+            pinRange(current.ss_sp, current.ss_size);
+        }
+        else
+        {
+            // One inaccessible page below the stack catches an overflow
+            std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            stack_size = (stack_size + page - 1) & ~(page - 1);
+            void* mapping = mmap(nullptr, stack_size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping != MAP_FAILED)
+            {
+                mprotect(mapping, page, PROT_NONE);
+                void* stack = static_cast<char*>(mapping) + page;
+                memset(stack, 0, stack_size);
+                pinRange(stack, stack_size);
+
+                stack_t alternate;
+                alternate.ss_sp = stack;
+                alternate.ss_size = stack_size;
+                alternate.ss_flags = 0;
+                if (sigaltstack(&alternate, nullptr) == 0)
+                {
+                    context.alternate_stack = mapping;
+                    context.alternate_stack_size = stack_size + page;
+                }
+                else
+                {
+                    munmap(mapping, stack_size + page);
+                }
+            }
+        }
+    }
+
+    if (!context.exception_reserve) {
+        refillExceptionReserve(context);
+    }
+    pinExceptionReserve(context.exception_reserve, true);
+
+    pinRange(&context, sizeof(context));
+    pinRange(&currentThreadContext, sizeof(currentThreadContext));
+    pinRange(&currentFaultAddress, sizeof(currentFaultAddress));
+}
+
+} // namespace
+
+ThreadRegistry& getThreadRegistry() {
+    static ThreadRegistry registry;
+    return registry;
+}
+
+std::mutex& getHandlersMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Removes a context from the registry when its thread exits without unregistering
+ThreadContext::~ThreadContext()
+{
+    releaseThreadResources(*this);
+
+    if (registered)
+    {
+        std::lock_guard<std::mutex> lock(getHandlersMutex());
+        getThreadRegistry().unlink(this);
+        registered = false;
+        if (profiler_armed) {
+            profiler::disarmThread(*this);
+        }
+    }
+
+    currentThreadContext = nullptr;
+    threadContextDestroyed = true;
+}
+
+MemoryFootprint getMemoryFootprint()
+{
+    MemoryFootprint footprint;
+    // The context and the TLS pointers, plus the exception reserve on the heap
+    // and the last exception thrown from one, which exception_hold keeps alive
+    std::size_t reserve_bytes = sizeof(AbiExceptionHeader) + sizeof(InvalidMemoryAccessException);
+    footprint.per_thread_bytes = sizeof(ThreadContext) + sizeof(currentThreadContext) + sizeof(currentFaultAddress) +
+                                 2 * reserve_bytes;
+    footprint.per_frame_bytes = sizeof(JumpBufferStack::Frame);
+    footprint.global_bytes = sizeof(ThreadRegistry) + sizeof(std::mutex) + sizeof(undoLogBytes);
+    {
+        std::lock_guard<std::mutex> lock(getHandlersMutex());
+        footprint.registered_threads = getThreadRegistry().count;
+    }
+    footprint.undo_log_bytes = undoLogBytes.load(std::memory_order_relaxed);
+    footprint.total_bytes = footprint.global_bytes + footprint.per_thread_bytes * footprint.registered_threads +
+                            footprint.undo_log_bytes;
+    return footprint;
+}
+
+TRY_CATCH_GUARD_FAULT_PATH void threadSegvHandler( int signal, siginfo_t *signalInfo, void *extra )
+{
+    // ********** Very Important ************
+    // Unblock the signal to allow to OS send again
+    sigset_t sigs;
+
+    memset( &sigs, 0 , sizeof( sigset_t ) );
+
+    sigemptyset( &sigs );
+    sigaddset( &sigs, signal );
+    sigprocmask( SIG_UNBLOCK, &sigs, NULL );
+    // ********** Very Important ************
+
+    // Store the fault address for later use
+    // (only faults detected by the kernel have one; kill/raise do not)
+    currentFaultAddress = signalInfo && signalInfo->si_code > 0 ? signalInfo->si_addr : nullptr;
+
+    // Hook of the range holding the address, then, inside a guard, hook of the
+    // innermost guard and hook of the thread. Outside of a guard the fault is
+    // not ours unless a range hook claims it.
+    FaultAction action = runRangeHook(currentFaultAddress, signal, signalInfo, extra);
+    if (action == FaultAction::Resume) {
+        return;
+    }
+
+    ThreadContext* thread = currentThreadContext;
+    JumpBufferStack::Frame* frame = thread ? thread->jmpbuf_stack.topFrame() : nullptr;
+    if (!frame || action == FaultAction::Chain)
+    {
+        chainSignal(signal, signalInfo, extra);
+        return;
+    }
+
+    if (action == FaultAction::Continue) {
+        action = runHook(frame->hook, signal, signalInfo, extra);
+    }
+    if (action == FaultAction::Continue) {
+        action = runHook(thread->thread_hook, signal, signalInfo, extra);
+    }
+
+    switch (action)
+    {
+    case FaultAction::Resume:
+        return;
+    case FaultAction::Chain:
+        chainSignal(signal, signalInfo, extra);
+        return;
+    case FaultAction::Unwind:
+    case FaultAction::Continue:
+        break;
+    }
+
+    // Don't pop the stack here, it will be popped in segvTryBlock after longjmp
+    recoveredFaults.fetch_add(1, std::memory_order_relaxed);
+
+    // Jump back to the setjmp call
+    context::resumeContext(frame->buffer, signal ? signal : 1);
+}
+
+void registerThreadHandler()
+{
+    // Use the thread-local context for this thread if it isn't registered yet
+    if (!currentThreadContext)
+    {
+        ThreadContext* newContext = &threadContextStorage;
+
+        // Assign to currentThreadContext
+        currentThreadContext = newContext;
+
+        newContext->thread_id = static_cast<int>(syscall(SYS_gettid));
+
+        // Late in thread exit: usable by the thread, invisible to the others
+        if (threadContextDestroyed)
+        {
+            releaseLateAttach();
+            return;
+        }
+
+        // Register the context in the global registry
+        {
+            std::lock_guard<std::mutex> lock(getHandlersMutex());
+            getThreadRegistry().link(currentThreadContext);
+            currentThreadContext->registered = true;
+            if (profiler::profilerRunning.load(std::memory_order_relaxed)) {
+                profiler::armThread(*currentThreadContext);
+            }
+        }
+
+        if (lowJitterEnabled.load(std::memory_order_acquire)) {
+            prepareLowJitterThread(*currentThreadContext);
+        }
+    }
+}
+
+void unregisterThreadHandler()
+{
+    if (currentThreadContext)
+    {
+        // Remove the context from the global registry
+        if (currentThreadContext->registered)
+        {
+            std::lock_guard<std::mutex> lock(getHandlersMutex());
+            getThreadRegistry().unlink(currentThreadContext);
+            currentThreadContext->registered = false;
+            if (currentThreadContext->profiler_armed) {
+                profiler::disarmThread(*currentThreadContext);
+            }
+        }
+
+        // The context storage is thread-local, nothing to free
+        currentThreadContext = nullptr;
+    }
+}
+
+void installGlobalHandlerOnce()
+{
+    std::call_once(globalHandlerInstalled, [] {
+        installSignalHandler(SIGSEGV);
+    });
+}
+
+void installSignalHandler(int signal)
+{
+    std::lock_guard<std::mutex> lock(installedSignalsMutex);
+    if (signal <= 0 || signal >= 64 || (installedSignals & (std::uint64_t(1) << signal))) {
+        return;
+    }
+
+    struct sigaction sa;
+
+    sa.sa_flags = SA_SIGINFO;
+    if (lowJitterEnabled.load(std::memory_order_relaxed)) {
+        sa.sa_flags |= SA_ONSTACK;
+    }
+
+    sigemptyset( &sa.sa_mask );
+
+    sa.sa_sigaction = threadSegvHandler;
+
+    sigaction( signal, &sa, &previousActions[signal] );
+    installedSignals |= std::uint64_t(1) << signal;
+}
+
+bool enableLowJitterMode(const LowJitterOptions& options)
+{
+    {
+        std::lock_guard<std::mutex> lock(installedSignalsMutex);
+        if (lowJitterEnabled.load(std::memory_order_relaxed)) {
+            return lowJitterAllLocked.load(std::memory_order_relaxed);
+        }
+        lowJitterOptions = options;
+        lowJitterEnabled.store(true, std::memory_order_release);
+
+        // Handlers installed so far switch to the alternate stack
+        for (int signal = 1; signal < 64; ++signal)
+        {
+            if (!(installedSignals & (std::uint64_t(1) << signal))) {
+                continue;
+            }
+            struct sigaction sa;
+            sigaction(signal, nullptr, &sa);
+            sa.sa_flags |= SA_ONSTACK;
+            sigaction(signal, &sa, nullptr);
+        }
+    }
+
+    pinRange(__start_tcg_fault_path, static_cast<std::size_t>(__stop_tcg_fault_path - __start_tcg_fault_path));
+
+    // The calling thread, then one recovery to warm up the rest of the path
+    // (signal delivery, unwinder, personality routine)
+    if (currentThreadContext) {
+        prepareLowJitterThread(*currentThreadContext);
+    }
+    _try {
+        volatile int* volatile target = nullptr;
+        *target = 0;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+    }
+    // The warm-up is not a fault of the program
+    recoveredFaults.fetch_sub(1, std::memory_order_relaxed);
+
+    return lowJitterAllLocked.load(std::memory_order_relaxed);
+}
+
+LowJitterStatus getLowJitterStatus()
+{
+    LowJitterStatus status;
+    status.enabled = lowJitterEnabled.load(std::memory_order_acquire);
+    status.all_locked = status.enabled && lowJitterOptions.lock_memory && lowJitterAllLocked.load(std::memory_order_relaxed);
+    status.handler_text_bytes = static_cast<std::size_t>(__stop_tcg_fault_path - __start_tcg_fault_path);
+    status.locked_bytes = lowJitterLockedBytes.load(std::memory_order_relaxed);
+    status.locked_reserves = lowJitterLockedReserves.load(std::memory_order_relaxed);
+    return status;
+}
+
+bool addFaultCleanup(void (*cleanup)(void*), void* argument)
+{
+    FaultCleanupList* list = currentThreadContext ? currentThreadContext->fault_cleanups : nullptr;
+    if (!list || list->count == FaultCleanupList::capacity) {
+        return false;
+    }
+
+    list->entries[list->count].cleanup = cleanup;
+    list->entries[list->count].argument = argument;
+    ++list->count;
+    return true;
+}
+
+ThreadContext* attachCurrentThread()
+{
+    // Ensure that the global handler is installed
+    installGlobalHandlerOnce();
+
+    // Register a handler for this thread
+    registerThreadHandler();
+
+    return currentThreadContext;
+}
+
+bool addRangeFaultHook(const void* begin, std::size_t size, FaultHandlerFn handler, void* context)
+{
+    if (size == 0 || !handler) {
+        return false;
+    }
+    installGlobalHandlerOnce();
+
+    std::lock_guard<std::mutex> lock(rangeHooksMutex);
+    for (std::size_t i = 0; i < maxRangeFaultHooks; ++i)
+    {
+        RangeHookSlot& slot = rangeHooks[i];
+        if (slot.end.load(std::memory_order_relaxed) != 0) {
+            continue;
+        }
+
+        slot.hook.handler = handler;
+        slot.hook.context = context;
+        slot.begin.store(reinterpret_cast<std::uintptr_t>(begin), std::memory_order_relaxed);
+        slot.end.store(reinterpret_cast<std::uintptr_t>(begin) + size, std::memory_order_seq_cst);
+        if (i >= rangeHookLimit.load(std::memory_order_relaxed)) {
+            rangeHookLimit.store(i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool removeRangeFaultHook(const void* begin)
+{
+    std::lock_guard<std::mutex> lock(rangeHooksMutex);
+    std::size_t limit = rangeHookLimit.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < limit; ++i)
+    {
+        RangeHookSlot& slot = rangeHooks[i];
+        if (slot.end.load(std::memory_order_relaxed) == 0 ||
+            slot.begin.load(std::memory_order_relaxed) != reinterpret_cast<std::uintptr_t>(begin)) {
+            continue;
+        }
+
+        slot.end.store(0, std::memory_order_seq_cst);
+        while (rangeHooksInFlight.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+        return true;
+    }
+    return false;
+}
+
+TRY_CATCH_GUARD_FAULT_PATH void throwInvalidMemoryAccess(int signal)
+{
+    // Create a more detailed error message based on the fault address
+    char message[InvalidMemoryAccessException::messageCapacity];
+    formatFaultMessage(message, currentFaultAddress);
+
+    ThreadContext* context = currentThreadContext;
+    void* storage = context ? context->exception_reserve : nullptr;
+    if (!storage) {
+        // No reserve (a guard policy other than throw_on_fault): allocate as usual
+        throw InvalidMemoryAccessException(message, signal);
+    }
+
+    context->exception_reserve = nullptr;
+    new (storage) InvalidMemoryAccessException(message, signal);
+    try {
+        abi::__cxa_throw(storage, const_cast<std::type_info*>(&typeid(InvalidMemoryAccessException)),
+                         destroyReservedException);
+    }
+    catch (...) {
+        // Taking a reference and rethrowing the same object does not allocate
+        context->exception_hold = std::current_exception();
+        throw;
+    }
+}
+
+void allocateUndoLog(ThreadContext& context)
+{
+    std::unique_ptr<UndoLog> log(new UndoLog);
+    log->entries = new UndoLog::Entry[UndoLog::initial_capacity];
+    log->capacity = UndoLog::initial_capacity;
+    context.undo_log = log.release();
+    undoLogBytes.fetch_add(sizeof(UndoLog) + UndoLog::initial_capacity * sizeof(UndoLog::Entry),
+                           std::memory_order_relaxed);
+}
+
+void growUndoLog(UndoLog& log)
+{
+    if (log.capacity >= UndoLog::max_entries) {
+        throw std::length_error("Undo log full: more than UndoLog::max_entries logged writes in one transaction");
+    }
+
+    std::size_t capacity = log.capacity * 2 < UndoLog::max_entries ? log.capacity * 2 : UndoLog::max_entries;
+    UndoLog::Entry* entries = new UndoLog::Entry[capacity];
+    memcpy(entries, log.entries, log.count * sizeof(UndoLog::Entry));
+    delete[] log.entries;
+    log.entries = entries;
+    undoLogBytes.fetch_add((capacity - log.capacity) * sizeof(UndoLog::Entry), std::memory_order_relaxed);
+    log.capacity = capacity;
+}
+
+void refillExceptionReserve(ThreadContext& context)
+{
+    // Frees the previous exception unless the program still refers to it
+    context.exception_hold = nullptr;
+    context.exception_reserve = abi::__cxa_allocate_exception(sizeof(InvalidMemoryAccessException));
+
+    // In low-jitter mode every reserve is pinned, not only the thread's first
+    if (lowJitterEnabled.load(std::memory_order_relaxed)) {
+        pinExceptionReserve(context.exception_reserve, false);
+    }
+}
+
+TRY_CATCH_GUARD_FAULT_PATH void simulateFault(int signal, void* address)
+{
+    ThreadContext* thread = currentThreadContext;
+    JumpBufferStack::Frame* frame = thread ? thread->jmpbuf_stack.topFrame() : nullptr;
+    if (!frame) {
+        return;
+    }
+
+    currentFaultAddress = address;
+    recoveredFaults.fetch_add(1, std::memory_order_relaxed);
+    context::resumeContext(frame->buffer, signal ? signal : 1);
+}
+
+TRY_CATCH_GUARD_FAULT_PATH bool safeRead(void* dst, const void* src, std::size_t size) noexcept
+{
+    ThreadContext* context = currentThreadContext;
+    if (!context) {
+        context = attachCurrentThread();
+    }
+
+    JumpBufferStack::Frame frame;
+
+    if (TRY_CATCH_GUARD_CAPTURE(frame.buffer) != 0)
+    {
+        context->jmpbuf_stack.pop();
+        return false;
+    }
+
+    context->jmpbuf_stack.push(frame);
+    memcpy(dst, src, size);
+    context->jmpbuf_stack.pop();
+    return true;
+}
+
+std::uint64_t getRecoveredFaultCount()
+{
+    return recoveredFaults.load(std::memory_order_relaxed);
+}
+
+} // namespace try_catch_guard
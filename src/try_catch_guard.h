@@ -0,0 +1,64 @@
+#ifndef TRY_CATCH_GUARD_H
+#define TRY_CATCH_GUARD_H
+
+/*
+ * C interface of the TryCatchGuard library, for C code and for language
+ * runtimes that cannot use the _try/_catch macros.
+ *
+ * No C++ exception crosses these functions: a fault or an exception raised by
+ * the guarded function is reported through the returned status code.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status codes returned by the guarded calls */
+typedef enum tcg_status {
+    TCG_OK = 0,               /* The function returned normally */
+    TCG_FAULT = 1,            /* An invalid memory access was recovered */
+    TCG_CPP_EXCEPTION = 2,    /* The function threw a C++ exception (it was caught) */
+    TCG_INVALID_ARGUMENT = 3  /* A required argument was NULL */
+} tcg_status;
+
+/* Details of a recovered fault */
+typedef struct tcg_fault_info {
+    int signal;               /* Signal number (SIGSEGV) */
+    void* address;            /* Faulting address reported by the kernel */
+} tcg_fault_info;
+
+/* Process-wide counters and memory use */
+typedef struct tcg_stats {
+    uint64_t recovered_faults;   /* Faults recovered by any guard since start */
+    uint64_t registered_threads; /* Threads currently registered */
+    uint64_t per_thread_bytes;   /* State of one thread, including its exception reserve */
+    uint64_t total_bytes;        /* Memory used by the library */
+    uint64_t undo_log_bytes;     /* Undo logs of the threads that have one (part of total_bytes) */
+} tcg_stats;
+
+typedef void (*tcg_fn)(void* arg);
+
+/* Calls fn(arg) inside a guard. On TCG_FAULT, *fault_info (if not NULL) describes the fault. */
+int tcg_call(tcg_fn fn, void* arg, tcg_fault_info* fault_info);
+
+/* Copies size bytes from src to dst; returns TCG_FAULT if src is not readable.
+   dst may be partially written when the copy faults. */
+int tcg_safe_read(void* dst, const void* src, size_t size);
+
+/* Fills *stats with the current counters */
+void tcg_get_stats(tcg_stats* stats);
+
+/* Releases the registration of the calling thread (see unregisterThreadHandler()) */
+void tcg_unregister_thread(void);
+
+/* Returns a static description of a status code */
+const char* tcg_status_string(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRY_CATCH_GUARD_H */
@@ -2,241 +2,764 @@
 #define TRY_CATCH_GUARD_HPP
 
 // Removed sigsegv.h dependency
+#include <atomic>
 #include <csetjmp>
 #include <csignal>
 #include <stdexcept>
 #include <exception>
 #include <functional>
 #include <thread>
-#include <unordered_map>
+#include <type_traits>
+#include <utility>
 #include <mutex>
-#include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <vector>
-#include <cstring> // For memcpy
-#include <memory>  // For std::shared_ptr and std::make_shared
-#include <stack>   // For std::stack
+#include <cstdint>
+#include <cstring> // For memset
+#include "context_capture.hpp"
 
 namespace try_catch_guard {
 
-// Custom exception for invalid memory accesses
+// Custom exception for invalid memory accesses.
+// The message is kept in a fixed buffer (truncated if longer), so creating or
+// copying the exception never allocates.
 class InvalidMemoryAccessException : public std::exception {
+public:
+    static constexpr std::size_t messageCapacity = 128;
+
 private:
-    std::string message;
+    char message[messageCapacity];
+    int signal_number; // Signal that was recovered
 
 public:
-    InvalidMemoryAccessException(const std::string& msg = "Invalid memory access detected") 
-        : message(msg) {}
+    InvalidMemoryAccessException(const char* msg = "Invalid memory access detected", int signal = SIGSEGV) noexcept
+        : signal_number(signal)
+    {
+        std::size_t length = strnlen(msg, messageCapacity - 1);
+        memcpy(message, msg, length);
+        message[length] = '\0';
+    }
+
+    InvalidMemoryAccessException(const std::string& msg, int signal = SIGSEGV) noexcept
+        : InvalidMemoryAccessException(msg.c_str(), signal) {}
 
     virtual const char* what() const noexcept override {
-        return message.c_str();
+        return message;
     }
+
+    // SIGSEGV, or the other signal a catch_signals<...> guard recovered
+    int signal() const noexcept { return signal_number; }
 };
 
-// Structure to store thread-specific information
-struct ThreadContext {
-    //std::stack<jmp_buf> jmpbuf_stack; // Stack of jump buffers for nested try blocks
-    std::stack<__jmp_buf_tag> jmpbuf_stack; //__jmp_buf_tag
-    bool active = false;
-    //std::function<int(void*, int)> handler;
-    std::function<void(int, siginfo_t*, void*)> handler;
+// What the signal handler does with a fault after a fault hook has seen it
+enum class FaultAction {
+    Unwind,   // Resume the innermost guard (the default without hooks)
+    Resume,   // Return from the signal handler and retry the faulting instruction
+    Continue, // The hook only recorded the fault; ask the next hook (guard, then thread), then unwind
+    Chain     // Pass the signal to the handler that was installed before the library's
 };
 
-// Global map to store thread-specific handlers
+// Fault hook: a plain function pointer and its context, called from the
+// signal handler. It must be async-signal-safe.
+using FaultHandlerFn = FaultAction (*)(void* context, int signal, siginfo_t* info, void* ucontext);
+
+struct FaultHook {
+    FaultHandlerFn handler = nullptr;
+    void* context = nullptr;
+};
+
+// Intrusive stack of jump buffers for nested try blocks.
+// Each frame lives in the stack frame of its segvTryBlock call, so pushing
+// and popping never allocate and the stack itself is only two words.
+class JumpBufferStack {
+public:
+    struct Frame {
+        CaptureContext buffer;
+        Frame* previous = nullptr;
+        FaultHook hook; // Per-guard hook, see setGuardFaultHook()
+    };
+
+    bool empty() const { return top_ == nullptr; }
+    std::size_t size() const { return size_; }
+
+    CaptureContext& top() { return top_->buffer; }
+    Frame* topFrame() { return top_; }
+
+    // The signal fences keep the compiler from sinking the push below (or
+    // hoisting the pop above) an inlined block that makes no calls, which
+    // would leave the frame invisible to the signal handler. They emit no code.
+    void push(Frame& frame)
+    {
+        frame.previous = top_;
+        top_ = &frame;
+        ++size_;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+
+    void pop()
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        top_ = top_->previous;
+        --size_;
+    }
+
+    // Keeps `frame` pushed for the lifetime of the scope, so the frame is
+    // also popped when a C++ exception leaves the guarded block. A fault
+    // resumes before the scope was entered, skipping its destructor; the
+    // fault path pops the frame itself.
+    class PushedFrame {
+    public:
+        PushedFrame(JumpBufferStack& stack, Frame& frame) : stack_(stack)
+        {
+            stack_.push(frame);
+        }
+
+        ~PushedFrame()
+        {
+            stack_.pop();
+        }
+
+        PushedFrame(const PushedFrame&) = delete;
+        PushedFrame& operator=(const PushedFrame&) = delete;
+
+    private:
+        JumpBufferStack& stack_;
+    };
+
+private:
+    Frame* top_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Cleanups registered with addFaultCleanup() for one guard.
+// Lives in the stack frame of the guard, like its jump buffer frame.
+struct FaultCleanupList {
+    static constexpr std::size_t capacity = 8;
+
+    struct Entry {
+        void (*cleanup)(void*);
+        void* argument;
+    };
+
+    Entry entries[capacity];
+    std::size_t count = 0;
+    FaultCleanupList* previous = nullptr;
+};
+
+// Per-thread undo log of policy::undo_log guards (see tx_write()). Allocated
+// by the first one, outside of the fault path, with room for
+// initial_capacity entries; the entries double when full, up to max_entries.
+struct UndoLog {
+    static constexpr std::size_t initial_capacity = 64;
+    static constexpr std::size_t max_entries = 4096;
+
+    // Old contents of up to 8 bytes at `address`
+    struct Entry {
+        void* address;
+        std::uint64_t value;
+        std::size_t size;
+    };
+
+    Entry* entries = nullptr;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+    std::size_t depth = 0; // Undo-logged guards active on the thread
+};
+
+// Structure to store thread-specific information.
+// Kept within two cache lines; see getMemoryFootprint().
+struct alignas(64) ThreadContext {
+    JumpBufferStack jmpbuf_stack; // Stack of jump buffers for nested try blocks
+
+    // Storage for the next InvalidMemoryAccessException, allocated before the
+    // fault so that throwing it does not allocate (see refillExceptionReserve())
+    void* exception_reserve = nullptr;
+
+    bool registered = false;
+    bool profiler_armed = false; // A profiler timer is running (see profiler.hpp)
+    int thread_id = 0;           // Kernel thread id, set at registration
+    FaultHook thread_hook;       // Per-thread hook, see setThreadFaultHook()
+
+    // Links of the intrusive thread registry (see getThreadRegistry())
+    ThreadContext* registry_previous = nullptr;
+    ThreadContext* registry_next = nullptr;
+
+    // Guard counters (policy::thread_stats) and the innermost fault cleanup
+    // list (policy::fault_cleanups)
+    std::uint64_t guard_entries = 0;
+    std::uint64_t guard_faults = 0;
+    FaultCleanupList* fault_cleanups = nullptr;
+
+    // Keeps the last exception thrown from the reserve alive until the next
+    // refill, so the end of the handler that caught it does not free memory
+    std::exception_ptr exception_hold;
+
+    // Mapping of the alternate signal stack allocated in low-jitter mode,
+    // including its guard page (see enableLowJitterMode())
+    void* alternate_stack = nullptr;
+    std::size_t alternate_stack_size = 0;
+
+    // SIGPROF timer of the sampling profiler (a timer_t)
+    void* profiler_timer = nullptr;
+
+    // Undo log of policy::undo_log guards, allocated by the first one
+    UndoLog* undo_log = nullptr;
+
+    // True while the thread is inside a guarded block
+    bool active() const { return !jmpbuf_stack.empty(); }
+
+    ~ThreadContext(); // Defined in try_catch_guard.cpp
+};
+
+static_assert(sizeof(ThreadContext) <= 128, "ThreadContext must fit in two cache lines");
+
+// Global registry of the contexts of all registered threads.
+// The contexts are linked intrusively, so registering a thread does not allocate.
 // Note: This requires synchronization as multiple threads may access it
-inline std::unordered_map<std::thread::id, std::shared_ptr<ThreadContext>>& getThreadHandlers() {
-    static std::unordered_map<std::thread::id, std::shared_ptr<ThreadContext>> handlers;
-    return handlers;
-}
+struct ThreadRegistry {
+    ThreadContext* head = nullptr;
+    std::size_t count = 0;
 
-inline std::mutex& getHandlersMutex() {
-    static std::mutex mutex;
-    return mutex;
-}
+    void link(ThreadContext* context)
+    {
+        context->registry_previous = nullptr;
+        context->registry_next = head;
+        if (head) {
+            head->registry_previous = context;
+        }
+        head = context;
+        ++count;
+    }
+
+    void unlink(ThreadContext* context)
+    {
+        if (context->registry_previous) {
+            context->registry_previous->registry_next = context->registry_next;
+        } else {
+            head = context->registry_next;
+        }
+        if (context->registry_next) {
+            context->registry_next->registry_previous = context->registry_previous;
+        }
+        context->registry_previous = nullptr;
+        context->registry_next = nullptr;
+        --count;
+    }
+};
+
+ThreadRegistry& getThreadRegistry();
+
+std::mutex& getHandlersMutex();
 
-// Thread-local variables for context and fault address
-thread_local static std::shared_ptr<ThreadContext> currentThreadContext = nullptr;
-thread_local static void* currentFaultAddress = nullptr;
+// Thread-local storage model for the library state.
+// The variables are defined once, in try_catch_guard.cpp; the initial-exec model
+// makes every access a single thread-pointer relative load, also from shared objects.
+#if defined(__GNUC__) || defined(__clang__)
+#define TRY_CATCH_GUARD_TLS __thread __attribute__((tls_model("initial-exec")))
+#else
+#define TRY_CATCH_GUARD_TLS thread_local
+#endif
+
+// Thread-local variables for context and fault address.
+// currentThreadContext points to the thread's context while the thread is registered.
+extern TRY_CATCH_GUARD_TLS ThreadContext* currentThreadContext;
+extern TRY_CATCH_GUARD_TLS void* currentFaultAddress;
+
+// Memory used by the library, in bytes
+struct MemoryFootprint {
+    std::size_t per_thread_bytes;   // State of one thread: its context, and its exception reserve and last exception on the heap
+    std::size_t per_frame_bytes;    // Stack space of one active _try block (jump buffer frame)
+    std::size_t global_bytes;       // Process-wide state (registry and its mutex)
+    std::size_t registered_threads; // Threads currently registered
+    std::size_t undo_log_bytes;     // Undo logs of the threads that have one (they grow with use)
+    std::size_t total_bytes;        // global_bytes + per_thread_bytes * registered_threads + undo_log_bytes
+};
+
+// Reports the exact memory footprint of the library
+MemoryFootprint getMemoryFootprint();
 
 // Thread-specific handler
+void threadSegvHandler( int signal = 0, siginfo_t *signalInfo = nullptr, void *extra = nullptr );
+
+// Registers a handler for the current thread
+void registerThreadHandler();
 
-//[[noreturn]] 
-void threadSegvHandler( int signal = 0, siginfo_t *signalInfo = nullptr, void *extra = nullptr )
+// Unregisters the handler for the current thread
+void unregisterThreadHandler();
+
+// One-time initializer for the global handler
+void installGlobalHandlerOnce();
+
+// Slow path of the first guard in a thread: installs the global handler,
+// registers the thread and returns its context
+ThreadContext* attachCurrentThread();
+
+// Sets the fault hook of the calling thread (a null handler removes it).
+// The signal handler calls it for every fault of the thread inside a guard,
+// after the hook of the innermost guard, if any.
+inline void setThreadFaultHook(FaultHandlerFn handler, void* context)
 {
-    // ********** Very Important ************
-    // Unblock the signal to allow to OS send again
-    sigset_t sigs;
-
-    memset( &sigs, 0 , sizeof( sigset_t ) );
-
-    sigemptyset( &sigs );
-    sigaddset( &sigs, signal );
-    sigprocmask( SIG_UNBLOCK, &sigs, NULL );
-    // ********** Very Important ************
-
-    // Store the fault address for later use
-    currentFaultAddress = nullptr;
-    
-    // We assume that currentThreadContext is not nullptr and is active
-    // and that jmpbuf_stack is not empty
-    if (!currentThreadContext->jmpbuf_stack.empty()) {
-        // Get a reference to the top jump buffer
-        __jmp_buf_tag& jumpBuffer = currentThreadContext->jmpbuf_stack.top();
-        
-        // Convert to jmp_buf for longjmp
-        jmp_buf localJumpBuffer;
-        std::memcpy(localJumpBuffer, &jumpBuffer, sizeof(jmp_buf));
-        
-        // Don't pop the stack here, it will be popped in segvTryBlock after longjmp
-        
-        // Jump back to the setjmp call
-        longjmp(localJumpBuffer, signal ? signal : 1);
-    }
+    ThreadContext* thread = currentThreadContext ? currentThreadContext : attachCurrentThread();
+    thread->thread_hook.context = context;
+    thread->thread_hook.handler = handler;
 }
 
-// Global handler that delegates to the thread-specific handler
-//inline int globalSegvHandler(void* addr, int serious)
-//[[noreturn]] 
-void globalSegvHandler( int signal = 0, siginfo_t *signalInfo = nullptr, void *extra = nullptr )
+// Sets the fault hook of the innermost guard of the calling thread; it is
+// called first for the faults inside that guard and goes away with it.
+// Returns false outside of a guard.
+inline bool setGuardFaultHook(FaultHandlerFn handler, void* context)
 {
-    // If we have a context for the current thread, we use its handler
-    if (currentThreadContext && currentThreadContext->active)
-    {
-        currentThreadContext->handler(signal, signalInfo, extra );
-        //return currentThreadContext->handler(addr, serious);
+    JumpBufferStack::Frame* frame = currentThreadContext ? currentThreadContext->jmpbuf_stack.topFrame() : nullptr;
+    if (!frame) {
+        return false;
     }
-    
-    // If we don't have a context, we return 0 to indicate that we don't handle the signal
-    //return 0;
+    frame->hook.context = context;
+    frame->hook.handler = handler;
+    return true;
 }
 
-// Registers a handler for the current thread
-inline void registerThreadHandler()
+// Number of range hooks that can be set at the same time
+constexpr std::size_t maxRangeFaultHooks = 32;
+
+// Sets a fault hook for the addresses in [begin, begin + size). The signal
+// handler runs range hooks first, for faults of any thread, inside a guard or
+// not; a fault outside every range, or whose hook returns Continue, goes on to
+// the guard and thread hooks. Ranges should not overlap. Installs the SIGSEGV
+// handler if needed. Returns false when every slot is taken.
+bool addRangeFaultHook(const void* begin, std::size_t size, FaultHandlerFn handler, void* context);
+
+// Removes the range hook set at `begin` and waits until no signal handler is
+// still running it, so its context can be released afterwards.
+// Returns false if there is no such hook.
+bool removeRangeFaultHook(const void* begin);
+
+// Throws the InvalidMemoryAccessException for the fault that was just recovered.
+// Neither the message nor the exception object is allocated when the thread's
+// reserve is filled, so recovery works even when the fault happened inside
+// the allocator.
+[[noreturn]] void throwInvalidMemoryAccess(int signal = SIGSEGV);
+
+// Releases the exception held since the last recovery and allocates the
+// thread's exception reserve; called by throw_on_fault outside of the fault path
+void refillExceptionReserve(ThreadContext& context);
+
+// Resumes the innermost guard of the calling thread as if `signal` had been
+// raised at `address`, without a signal (no kernel round trip, no hooks).
+// Returns only when the thread is not inside a guard.
+void simulateFault(int signal, void* address);
+
+// Copies `size` bytes from `src` to `dst` inside a guard.
+// Returns false if `src` is not readable; `dst` may then be partially written.
+bool safeRead(void* dst, const void* src, std::size_t size) noexcept;
+
+// Number of faults recovered by any guard since the process started
+std::uint64_t getRecoveredFaultCount();
+
+// Describes a fault recovered by a guard
+struct FaultInfo {
+    int signal = 0;           // Signal that was recovered (0 when no fault occurred)
+    void* address = nullptr;  // Faulting address reported by the kernel
+};
+
+// Result of a guard using policy::result_on_fault
+struct GuardResult : FaultInfo {
+    bool faulted() const { return signal != 0; }
+    explicit operator bool() const { return !faulted(); }
+};
+
+// Per-thread guard counters kept by policy::thread_stats
+struct GuardStats {
+    std::uint64_t entries = 0;
+    std::uint64_t faults = 0;
+};
+
+// Returns the counters of the calling thread
+inline GuardStats getThreadGuardStats()
 {
-    std::thread::id this_id = std::this_thread::get_id();
-    
-    // Create a new context for this thread if it doesn't exist
-    if (!currentThreadContext)
+    GuardStats stats;
+    if (currentThreadContext)
     {
-        // Create a new ThreadContext with proper initialization
-        auto newContext = std::make_shared<ThreadContext>();
-        newContext->active = false;
-        newContext->handler = threadSegvHandler;
-        
-        // Assign to currentThreadContext
-        currentThreadContext = newContext;
-        
-        // Register the context in the global map
-        std::lock_guard<std::mutex> lock(getHandlersMutex());
-        getThreadHandlers()[this_id] = currentThreadContext;
+        stats.entries = currentThreadContext->guard_entries;
+        stats.faults = currentThreadContext->guard_faults;
     }
+    return stats;
 }
 
-// Unregisters the handler for the current thread
-inline void unregisterThreadHandler()
+// Registers `cleanup(argument)` to run if the innermost guard using
+// policy::fault_cleanups is left through a fault. Destructors of objects in
+// the block do not run on a fault, so this is where locks and resources are
+// released. Returns false if there is no such guard or its list is full.
+bool addFaultCleanup(void (*cleanup)(void*), void* argument);
+
+// Allocates the undo log of the calling thread; called by policy::undo_log
+// outside of the fault path
+void allocateUndoLog(ThreadContext& context);
+
+// Doubles the entries of a full undo log; throws std::length_error when it
+// already holds UndoLog::max_entries
+void growUndoLog(UndoLog& log);
+
+// Records the `size` bytes at `address` in the undo log of the calling
+// thread, if it is inside a policy::undo_log guard (e.g. _try_tx), so they
+// are restored if the guard faults or throws. Costs a few stores per 8 bytes.
+inline void tx_record(void* address, std::size_t size)
 {
-    if (currentThreadContext)
+    ThreadContext* context = currentThreadContext;
+    UndoLog* log = context ? context->undo_log : nullptr;
+    if (!log || log->depth == 0) {
+        return;
+    }
+
+    char* bytes = static_cast<char*>(address);
+    while (size > 0)
     {
-        std::thread::id this_id = std::this_thread::get_id();
-        
-        // Remove the context from the global map
-        {
-            std::lock_guard<std::mutex> lock(getHandlersMutex());
-            getThreadHandlers().erase(this_id);
+        if (__builtin_expect(log->count == log->capacity, 0)) {
+            growUndoLog(*log);
         }
-        
-        // No need to delete manually, shared_ptr will handle it
-        currentThreadContext = nullptr;
+        std::size_t chunk = size < sizeof(std::uint64_t) ? size : sizeof(std::uint64_t);
+        UndoLog::Entry& entry = log->entries[log->count++];
+        entry.address = bytes;
+        entry.value = 0;
+        memcpy(&entry.value, bytes, chunk);
+        entry.size = chunk;
+        bytes += chunk;
+        size -= chunk;
     }
 }
 
-// One-time initializer for the global handler
-inline void installGlobalHandlerOnce()
+// Writes `value` through `ptr` after recording the old value (see tx_record())
+template <typename T, typename U>
+inline void tx_write(T* ptr, U&& value)
 {
-    static bool installed = false;
-    if (!installed)
-    {
+    static_assert(std::is_trivially_copyable<T>::value, "tx_write() restores values bytewise");
+    tx_record(ptr, sizeof(T));
+    *ptr = std::forward<U>(value);
+}
+
+// Installs the library signal handler for `signal` (idempotent)
+void installSignalHandler(int signal);
+
+// Options of the low-jitter mode
+struct LowJitterOptions {
+    bool lock_memory = true;                      // mlock() the ranges, not only pre-touch them
+    std::size_t alternate_stack_size = 64 * 1024; // Per-thread signal stack (0 keeps the thread's stack)
+};
+
+struct LowJitterStatus {
+    bool enabled = false;
+    bool all_locked = false;            // Every mlock() so far succeeded
+    std::size_t handler_text_bytes = 0; // Size of the fault-path code
+    std::size_t locked_bytes = 0;       // Bytes locked so far (whole pages)
+    std::size_t locked_reserves = 0;    // Exception reserves locked so far (one per recovery)
+};
+
+// Opt-in mode for predictable recovery latency: the fault-path code is
+// pre-touched and locked in memory, signal handlers run on a per-thread
+// alternate stack (SA_ONSTACK), and every thread registered from now on gets
+// its stack, thread context and exception reserve pre-touched and locked. The
+// reserve refilled after each recovery is locked as well.
+// One recovery is performed to warm up the path. Cannot be turned off.
+// Returns false if some memory could not be locked (see RLIMIT_MEMLOCK); the
+// ranges are still pre-touched.
+bool enableLowJitterMode(const LowJitterOptions& options = LowJitterOptions());
+
+LowJitterStatus getLowJitterStatus();
+
+// Compile-time policies of basic_guard. Each policy belongs to one category;
+// a category that is not given uses its default (the first one listed).
+namespace policy {
+
+struct signal_category {};
+struct unwind_category {};
+struct stats_category {};
+struct cleanup_category {};
+struct undo_category {};
+
+// Signals for which the guard installs the handler (default: SIGSEGV).
+// The handler is process-wide: once installed, a signal is recovered by the
+// innermost guard of the thread, whatever its own signal policy.
+template <int... Signals>
+struct catch_signals {
+    using category = signal_category;
 
-        /*
-        // Use standard signal handling instead of sigsegv library
-        if (std::signal(SIGSEGV, [](int sig) {
-            // Call our global handler with nullptr as we don't have the exact address
-            globalSegvHandler(nullptr, 1);
-        }) == SIG_ERR)
+    static void install()
+    {
+        if constexpr (!(sizeof...(Signals) == 1 && ((Signals == SIGSEGV) && ...)))
         {
-            std::cerr << "Failed to install global SIGSEGV handler" << std::endl;
-            std::exit(1);
-        }
-        */
-
-        struct sigaction sa;
-
-        sa.sa_flags = SA_SIGINFO;
-          
-        sigemptyset( &sa.sa_mask );
-          
-        sa.sa_sigaction = threadSegvHandler; //(void (*)(int, siginfo_t *, void *))
-          
-        //sigaction( SIGILL, &sa, NULL );
-        //sigaction( SIGFPE, &sa, NULL );
-        sigaction( SIGSEGV, &sa, NULL );            
-        installed = true;
+            // SIGSEGV alone is installed when the thread attaches
+            static const bool installed = (installSignalHandler(Signals), ..., true);
+            (void)installed;
+        }
     }
-}
+};
 
-// Internal function that throws an exception if we exit with longjmp
-inline void segvTryBlock(const std::function<void()> &block)
-{
-    // Ensure that the global handler is installed
-    installGlobalHandlerOnce();
-    
-    // Register a handler for this thread
-    registerThreadHandler();
-    
-    // Activate the handler for this thread
-    currentThreadContext->active = true;
-    
-    // Create a new jump buffer for this try block
-    jmp_buf jmpbuf {};
-    
-    // Push the jump buffer onto the stack
-    //currentThreadContext->jmpbuf_stack.push(jmpbuf[0]);
-    
-    //if (setjmp(currentThreadContext->jmpbuf_stack.top()) == 0)
-    if (setjmp(jmpbuf) == 0)
+// Throws InvalidMemoryAccessException on a fault (default). The exception is
+// built in the thread's reserve, which is refilled by the first guard entered
+// after a recovery.
+struct throw_on_fault {
+    using category = unwind_category;
+    using result_type = void;
+
+    static void onEnter(ThreadContext& context)
     {
-        currentThreadContext->jmpbuf_stack.push(jmpbuf[0]);
-        block(); // Execute the "_try" block
+        if (__builtin_expect(context.exception_reserve == nullptr, 0)) {
+            refillExceptionReserve(context);
+        }
     }
-    else
+    static void onSuccess() {}
+    [[noreturn]] static void onFault(const FaultInfo& fault) { throwInvalidMemoryAccess(fault.signal); }
+};
+
+// Returns a GuardResult describing the fault instead of throwing
+struct result_on_fault {
+    using category = unwind_category;
+    using result_type = GuardResult;
+
+    static void onEnter(ThreadContext&) {}
+    static GuardResult onSuccess() { return GuardResult(); }
+    static GuardResult onFault(const FaultInfo& fault)
     {
-        currentThreadContext->active = false;
-        
-        // Pop the jump buffer from the stack
-        currentThreadContext->jmpbuf_stack.pop();
-        
-        // Create a more detailed error message based on the fault address
-        std::stringstream ss;
-        //ss << "SIGSEGV caught: invalid memory access at address " << currentFaultAddress;
-        
-        // Add more specific information if possible
-        if (currentFaultAddress == nullptr) {
-            ss << "Invalid null pointer access exception";
-            //ss << " (null pointer)";
-        }else {
-            ss << "Invalid memory access exception at address (0x" << std::hex << std::uppercase << reinterpret_cast<uintptr_t>(currentFaultAddress) << ")";
-        }
-        
-        throw InvalidMemoryAccessException(ss.str());
+        GuardResult result;
+        result.signal = fault.signal;
+        result.address = fault.address;
+        return result;
     }
-    
-    // Pop the jump buffer from the stack
-    if (!currentThreadContext->jmpbuf_stack.empty()) {
-        currentThreadContext->jmpbuf_stack.pop();
+};
+
+// Calls Callback with the fault and returns normally
+template <void (*Callback)(const FaultInfo&)>
+struct callback_on_fault {
+    using category = unwind_category;
+    using result_type = void;
+
+    static void onEnter(ThreadContext&) {}
+    static void onSuccess() {}
+    static void onFault(const FaultInfo& fault) { Callback(fault); }
+};
+
+// No counters (default)
+struct no_stats {
+    using category = stats_category;
+
+    static void onEnter(ThreadContext&) {}
+    static void onFault(ThreadContext&) {}
+};
+
+// Counts entries and faults per thread; see getThreadGuardStats()
+struct thread_stats {
+    using category = stats_category;
+
+    static void onEnter(ThreadContext& context) { ++context.guard_entries; }
+    static void onFault(ThreadContext& context) { ++context.guard_faults; }
+};
+
+// No fault cleanups (default)
+struct no_cleanups {
+    using category = cleanup_category;
+
+    struct Scope {
+        explicit Scope(ThreadContext&) {}
+        void runOnFault() {}
+    };
+};
+
+// The block may register cleanups with addFaultCleanup()
+struct fault_cleanups {
+    using category = cleanup_category;
+
+    class Scope {
+    public:
+        explicit Scope(ThreadContext& context) : context_(context)
+        {
+            list_.previous = context.fault_cleanups;
+            context.fault_cleanups = &list_;
+        }
+
+        ~Scope()
+        {
+            context_.fault_cleanups = list_.previous;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Runs the registered cleanups, the most recent first
+        void runOnFault()
+        {
+            context_.fault_cleanups = list_.previous;
+            while (list_.count > 0)
+            {
+                --list_.count;
+                list_.entries[list_.count].cleanup(list_.entries[list_.count].argument);
+            }
+        }
+
+    private:
+        ThreadContext& context_;
+        FaultCleanupList list_;
+    };
+};
+
+// No undo log (default); tx_write() only writes
+struct no_undo_log {
+    using category = undo_category;
+
+    struct Scope {
+        explicit Scope(ThreadContext&) {}
+        void commit() {}
+        void runOnFault() {}
+    };
+};
+
+// Writes made with tx_write() inside the block are undone, newest first, if
+// the block faults or throws. A nested undo-logged guard that returns keeps
+// its entries, so the enclosing one still undoes them.
+struct undo_log {
+    using category = undo_category;
+
+    class Scope {
+    public:
+        explicit Scope(ThreadContext& context)
+        {
+            if (__builtin_expect(context.undo_log == nullptr, 0)) {
+                allocateUndoLog(context);
+            }
+            log_ = context.undo_log;
+            mark_ = log_->count;
+            ++log_->depth;
+        }
+
+        // Reached without commit() only when an exception leaves the block
+        ~Scope()
+        {
+            if (log_) {
+                runOnFault();
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void commit()
+        {
+            if (--log_->depth == 0) {
+                log_->count = 0;
+            }
+            log_ = nullptr;
+        }
+
+        // Restores the entries logged since the guard was entered
+        void runOnFault()
+        {
+            UndoLog& log = *log_;
+            while (log.count > mark_)
+            {
+                const UndoLog::Entry& entry = log.entries[--log.count];
+                memcpy(entry.address, &entry.value, entry.size);
+            }
+            --log.depth;
+            log_ = nullptr;
+        }
+
+    private:
+        UndoLog* log_;
+        std::size_t mark_;
+    };
+};
+
+// Finds the policy of `Category` in `Policies`, or `Default`
+template <typename Category, typename Default, typename... Policies>
+struct select;
+
+template <typename Category, typename Default>
+struct select<Category, Default> {
+    using type = Default;
+};
+
+template <typename Category, typename Default, typename First, typename... Rest>
+struct select<Category, Default, First, Rest...> {
+    using type = typename std::conditional<std::is_same<typename First::category, Category>::value,
+                                           First,
+                                           typename select<Category, Default, Rest...>::type>::type;
+};
+
+} // namespace policy
+
+// Guard configured at compile time, e.g.
+//   basic_guard<policy::result_on_fault, policy::thread_stats>::run([&] { ... });
+// Features that are not selected compile away: with the defaults the guard
+// is a setjmp, a push onto the thread's jump buffer stack and a pop.
+template <typename... Policies>
+class basic_guard {
+public:
+    using signal_policy = typename policy::select<policy::signal_category, policy::catch_signals<SIGSEGV>, Policies...>::type;
+    using unwind_policy = typename policy::select<policy::unwind_category, policy::throw_on_fault, Policies...>::type;
+    using stats_policy = typename policy::select<policy::stats_category, policy::no_stats, Policies...>::type;
+    using cleanup_policy = typename policy::select<policy::cleanup_category, policy::no_cleanups, Policies...>::type;
+    using undo_policy = typename policy::select<policy::undo_category, policy::no_undo_log, Policies...>::type;
+    using result_type = typename unwind_policy::result_type;
+
+    template <typename Block>
+    static result_type run(Block&& block)
+    {
+        ThreadContext* context = currentThreadContext;
+        if (__builtin_expect(context == nullptr, 0)) {
+            context = attachCurrentThread();
+        }
+        signal_policy::install();
+        unwind_policy::onEnter(*context);
+        stats_policy::onEnter(*context);
+
+        typename undo_policy::Scope undo(*context);
+        typename cleanup_policy::Scope cleanups(*context);
+
+        // Create a new jump buffer frame for this try block
+        JumpBufferStack::Frame frame;
+
+        int signal = TRY_CATCH_GUARD_CAPTURE(frame.buffer);
+        if (signal != 0)
+        {
+            // Pop the jump buffer from the stack
+            context->jmpbuf_stack.pop();
+
+            // Old values first, while the locks released by cleanups are held
+            undo.runOnFault();
+            cleanups.runOnFault();
+            stats_policy::onFault(*context);
+
+            FaultInfo fault;
+            fault.signal = signal;
+            fault.address = currentFaultAddress;
+            return unwind_policy::onFault(fault);
+        }
+
+        {
+            // Push the jump buffer frame onto the stack until the block is left
+            JumpBufferStack::PushedFrame pushed(context->jmpbuf_stack, frame);
+            block(); // Execute the "_try" block
+        }
+
+        undo.commit();
+        return unwind_policy::onSuccess();
     }
-    
-    currentThreadContext->active = false;
+};
+
+// Guard used by _try: SIGSEGV, throws InvalidMemoryAccessException
+using default_guard = basic_guard<>;
+
+// Guard used by _try_tx: the default guard plus the undo log of tx_write()
+using tx_guard = basic_guard<policy::undo_log>;
+
+// Internal function that throws an exception if we exit with longjmp.
+// Only the fast path is inline; registration and error reporting are out of line.
+inline void segvTryBlock(const std::function<void()> &block)
+{
+    default_guard::run(block);
+}
+
+// segvTryBlock for _try_tx
+inline void segvTxTryBlock(const std::function<void()> &block)
+{
+    tx_guard::run(block);
 }
 
 } // namespace try_catch_guard
@@ -246,6 +769,11 @@ inline void segvTryBlock(const std::function<void()> &block)
     try      \
     { try_catch_guard::segvTryBlock([&]()
 
+// _try whose tx_write() calls are undone if the block faults or throws
+#define _try_tx \
+    try         \
+    { try_catch_guard::segvTxTryBlock([&]()
+
 #define _catch(type, var)                                                                                                                  \
                                                                                                                                         ); \
     }                                                                                                                                      \
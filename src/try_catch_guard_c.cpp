@@ -0,0 +1,121 @@
+// C interface of the TryCatchGuard library (see try_catch_guard.h).
+//
+// tcg_call() enters the guard directly, without a std::function, so a guarded
+// call from C costs the same as the inline _try fast path plus one indirect call.
+// Every C++ exception is caught here and turned into a status code.
+
+#include "try_catch_guard.h"
+#include "try_catch_guard.hpp"
+
+#include <cxxabi.h>
+
+namespace {
+
+using namespace try_catch_guard;
+
+void fillFaultInfo(tcg_fault_info* fault_info, int signal)
+{
+    if (fault_info)
+    {
+        fault_info->signal = signal;
+        fault_info->address = currentFaultAddress;
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+int tcg_call(tcg_fn fn, void* arg, tcg_fault_info* fault_info)
+{
+    if (!fn) {
+        return TCG_INVALID_ARGUMENT;
+    }
+
+    ThreadContext* context = currentThreadContext;
+    if (__builtin_expect(context == nullptr, 0))
+    {
+        try {
+            context = attachCurrentThread();
+        }
+        catch (...) {
+            return TCG_CPP_EXCEPTION;
+        }
+    }
+
+    JumpBufferStack::Frame frame;
+    int signal = TRY_CATCH_GUARD_CAPTURE(frame.buffer);
+
+    if (signal != 0)
+    {
+        context->jmpbuf_stack.pop();
+        fillFaultInfo(fault_info, signal);
+        return TCG_FAULT;
+    }
+
+    // The frame is popped before any of the handlers below runs
+    try {
+        JumpBufferStack::PushedFrame pushed(context->jmpbuf_stack, frame);
+        fn(arg);
+    }
+    catch (const InvalidMemoryAccessException& e) {
+        // A fault recovered by a nested _try that fn did not catch
+        fillFaultInfo(fault_info, e.signal());
+        return TCG_FAULT;
+    }
+    catch (abi::__forced_unwind&) {
+        // Thread cancellation must keep unwinding
+        throw;
+    }
+    catch (...) {
+        return TCG_CPP_EXCEPTION;
+    }
+
+    return TCG_OK;
+}
+
+int tcg_safe_read(void* dst, const void* src, size_t size)
+{
+    if ((!dst || !src) && size != 0) {
+        return TCG_INVALID_ARGUMENT;
+    }
+    return safeRead(dst, src, size) ? TCG_OK : TCG_FAULT;
+}
+
+void tcg_get_stats(tcg_stats* stats)
+{
+    if (!stats) {
+        return;
+    }
+
+    MemoryFootprint footprint = getMemoryFootprint();
+    stats->recovered_faults = getRecoveredFaultCount();
+    stats->registered_threads = footprint.registered_threads;
+    stats->per_thread_bytes = footprint.per_thread_bytes;
+    stats->total_bytes = footprint.total_bytes;
+    stats->undo_log_bytes = footprint.undo_log_bytes;
+}
+
+void tcg_unregister_thread(void)
+{
+    unregisterThreadHandler();
+}
+
+const char* tcg_status_string(int status)
+{
+    switch (status)
+    {
+    case TCG_OK:
+        return "ok";
+    case TCG_FAULT:
+        return "invalid memory access";
+    case TCG_CPP_EXCEPTION:
+        return "C++ exception";
+    case TCG_INVALID_ARGUMENT:
+        return "invalid argument";
+    default:
+        return "unknown status";
+    }
+}
+
+} // extern "C"
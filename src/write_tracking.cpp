@@ -0,0 +1,232 @@
+// Write-tracked regions (see write_tracking.hpp).
+
+#include "write_tracking.hpp"
+
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace try_catch_guard {
+namespace tracking {
+
+WriteTrackedRegion::WriteTrackedRegion(std::size_t size)
+    : base_(nullptr),
+      page_size_(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+      pages_((size + page_size_ - 1) / page_size_),
+      words_((pages_ + 63) / 64),
+      dirty_(new std::atomic<std::uint64_t>[words_ ? words_ : 1]),
+      write_faults_(0),
+      checkpoints_(0),
+      pages_copied_(0),
+      protect_calls_(0),
+      protect_failures_(0)
+{
+    if (pages_ == 0) {
+        throw std::bad_alloc();
+    }
+
+    void* mapping = mmap(nullptr, pages_ * page_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    base_ = static_cast<char*>(mapping);
+
+    // Nothing was checkpointed yet: every page is dirty and writable
+    for (std::size_t word = 0; word < words_; ++word)
+    {
+        std::size_t remaining = pages_ - word * 64;
+        dirty_[word].store(remaining >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << remaining) - 1,
+                           std::memory_order_relaxed);
+    }
+
+    if (!addRangeFaultHook(base_, pages_ * page_size_, onFault, this))
+    {
+        munmap(base_, pages_ * page_size_);
+        throw std::bad_alloc();
+    }
+}
+
+WriteTrackedRegion::~WriteTrackedRegion()
+{
+    removeRangeFaultHook(base_);
+    munmap(base_, pages_ * page_size_);
+}
+
+// Makes the page writable before marking it dirty: a checkpoint that clears
+// the bit in between leaves the page writable and dirty, never writable and
+// clean. Concurrent faults on the same page both unprotect it.
+FaultAction WriteTrackedRegion::onFault(void* context, int signal, siginfo_t* info, void*)
+{
+    WriteTrackedRegion* region = static_cast<WriteTrackedRegion*>(context);
+    if (signal != SIGSEGV || !info || info->si_code != SEGV_ACCERR) {
+        return FaultAction::Continue;
+    }
+
+    std::size_t page = (static_cast<char*>(info->si_addr) - region->base_) / region->page_size_;
+    if (mprotect(region->base_ + page * region->page_size_, region->page_size_, PROT_READ | PROT_WRITE) != 0) {
+        return FaultAction::Continue;
+    }
+
+    region->dirty_[page / 64].fetch_or(std::uint64_t(1) << (page % 64), std::memory_order_release);
+    region->write_faults_.fetch_add(1, std::memory_order_relaxed);
+    return FaultAction::Resume;
+}
+
+// The dirty bits of the run were cleared already. If the run cannot be
+// protected (e.g. ENOMEM when the split would exceed the mapping limit), the
+// bits are set again, so the pages stay dirty and are copied by every
+// checkpoint until one protects them, instead of being written unnoticed.
+void WriteTrackedRegion::protectRun(std::size_t first, std::size_t count)
+{
+    ++protect_calls_;
+    if (mprotect(base_ + first * page_size_, count * page_size_, PROT_READ) == 0) {
+        return;
+    }
+
+    ++protect_failures_;
+    for (std::size_t page = first; page < first + count; ++page) {
+        dirty_[page / 64].fetch_or(std::uint64_t(1) << (page % 64), std::memory_order_relaxed);
+    }
+}
+
+void WriteTrackedRegion::finishCheckpoint(std::size_t visited)
+{
+    ++checkpoints_;
+    pages_copied_ += visited;
+}
+
+std::size_t WriteTrackedRegion::dirtyPageCount() const
+{
+    std::size_t count = 0;
+    for (std::size_t word = 0; word < words_; ++word) {
+        count += static_cast<std::size_t>(__builtin_popcountll(dirty_[word].load(std::memory_order_relaxed)));
+    }
+    return count;
+}
+
+WriteTrackingStats WriteTrackedRegion::stats() const
+{
+    WriteTrackingStats stats;
+    stats.write_faults = write_faults_.load(std::memory_order_relaxed);
+    stats.checkpoints = checkpoints_;
+    stats.pages_copied = pages_copied_;
+    stats.protect_calls = protect_calls_;
+    stats.protect_failures = protect_failures_;
+    return stats;
+}
+
+RollbackRegion::RollbackRegion(std::size_t size)
+    : base_(nullptr),
+      shadow_(nullptr),
+      page_size_(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+      pages_((size + page_size_ - 1) / page_size_),
+      words_((pages_ + 63) / 64),
+      saved_(new std::atomic<std::uint64_t>[words_ ? words_ : 1]()),
+      active_(false),
+      pages_saved_(0),
+      transactions_(0),
+      rollbacks_(0),
+      pages_restored_(0)
+{
+    if (pages_ == 0) {
+        throw std::bad_alloc();
+    }
+
+    // The region and its shadow in one mapping
+    void* mapping = mmap(nullptr, 2 * pages_ * page_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    base_ = static_cast<char*>(mapping);
+    shadow_ = base_ + pages_ * page_size_;
+
+    if (!addRangeFaultHook(base_, pages_ * page_size_, onFault, this))
+    {
+        munmap(base_, 2 * pages_ * page_size_);
+        throw std::bad_alloc();
+    }
+}
+
+RollbackRegion::~RollbackRegion()
+{
+    removeRangeFaultHook(base_);
+    munmap(base_, 2 * pages_ * page_size_);
+}
+
+// The bit is claimed before the page is copied, so a concurrent fault on the
+// same page cannot save it again after the first writer changed it; that
+// fault is retried until the page is unprotected.
+FaultAction RollbackRegion::onFault(void* context, int signal, siginfo_t* info, void*)
+{
+    RollbackRegion* region = static_cast<RollbackRegion*>(context);
+    if (signal != SIGSEGV || !info || info->si_code != SEGV_ACCERR || !region->active_.load(std::memory_order_acquire)) {
+        return FaultAction::Continue;
+    }
+
+    std::size_t page = (static_cast<char*>(info->si_addr) - region->base_) / region->page_size_;
+    std::uint64_t bit = std::uint64_t(1) << (page % 64);
+    if (region->saved_[page / 64].fetch_or(bit, std::memory_order_acq_rel) & bit) {
+        return FaultAction::Resume;
+    }
+
+    std::size_t offset = page * region->page_size_;
+    memcpy(region->shadow_ + offset, region->base_ + offset, region->page_size_);
+    if (mprotect(region->base_ + offset, region->page_size_, PROT_READ | PROT_WRITE) != 0)
+    {
+        region->saved_[page / 64].fetch_and(~bit, std::memory_order_relaxed);
+        return FaultAction::Continue;
+    }
+
+    region->pages_saved_.fetch_add(1, std::memory_order_relaxed);
+    return FaultAction::Resume;
+}
+
+void RollbackRegion::begin()
+{
+    if (active_.exchange(true, std::memory_order_acq_rel)) {
+        throw std::logic_error("RollbackRegion transactions do not nest");
+    }
+    ++transactions_;
+    mprotect(base_, pages_ * page_size_, PROT_READ);
+}
+
+void RollbackRegion::commit()
+{
+    mprotect(base_, pages_ * page_size_, PROT_READ | PROT_WRITE);
+    for (std::size_t word = 0; word < words_; ++word) {
+        saved_[word].store(0, std::memory_order_relaxed);
+    }
+    active_.store(false, std::memory_order_release);
+}
+
+// Saved pages are writable already; the others were not changed
+void RollbackRegion::rollback()
+{
+    for (std::size_t word = 0; word < words_; ++word)
+    {
+        std::uint64_t bits = saved_[word].exchange(0, std::memory_order_acq_rel);
+        while (bits != 0)
+        {
+            std::size_t page = word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+            memcpy(base_ + page * page_size_, shadow_ + page * page_size_, page_size_);
+            ++pages_restored_;
+            bits &= bits - 1;
+        }
+    }
+    ++rollbacks_;
+    mprotect(base_, pages_ * page_size_, PROT_READ | PROT_WRITE);
+    active_.store(false, std::memory_order_release);
+}
+
+RollbackStats RollbackRegion::stats() const
+{
+    RollbackStats stats;
+    stats.transactions = transactions_;
+    stats.rollbacks = rollbacks_;
+    stats.pages_saved = pages_saved_.load(std::memory_order_relaxed);
+    stats.pages_restored = pages_restored_;
+    return stats;
+}
+
+} // namespace tracking
+} // namespace try_catch_guard
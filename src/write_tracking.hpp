@@ -0,0 +1,242 @@
+#ifndef TRY_CATCH_GUARD_WRITE_TRACKING_HPP
+#define TRY_CATCH_GUARD_WRITE_TRACKING_HPP
+
+// Page-granular write tracking for incremental checkpoints.
+//
+// A WriteTrackedRegion is a mapping whose pages are write-protected after
+// each checkpoint. The first write to a protected page faults; a range hook
+// (see addRangeFaultHook()) marks the page in a dirty bitmap, makes it
+// writable and returns FaultAction::Resume, so the write is retried and the
+// program goes on without any unwind, inside a guard or not. A checkpoint
+// then only visits the pages written since the previous one:
+//
+//   tracking::WriteTrackedRegion state(64 << 20);
+//   Arena arena(state.data(), state.size());
+//   ...
+//   std::vector<char> snapshot(state.size());
+//   state.checkpoint(snapshot.data()); // copies the dirty pages only
+//
+// Every page starts dirty, so the first checkpoint copies the whole region.
+// A checkpoint write-protects each run of consecutive dirty pages with one
+// mprotect() call and reads the run afterwards: a write racing with the
+// checkpoint either lands before the protection (and is copied) or faults
+// and makes the page dirty for the next checkpoint. Writes made by the kernel
+// (e.g. read() into the region) do not fault and fail with EFAULT on a
+// protected page; write to the region from user code only.
+//
+// A RollbackRegion uses the same mechanism for all-or-nothing updates. Its
+// pages are write-protected while a transaction runs; the first write to a
+// page saves the original page before unprotecting it. If the transaction
+// faults (or throws), every saved page is copied back before the exception
+// reaches the handler:
+//
+//   tracking::RollbackRegion table(1 << 30);
+//   _try_rollback(table) {
+//       updateTable(table.data());
+//   }
+//   _catch(InvalidMemoryAccessException, e) {
+//       // table is exactly as it was before the block
+//   }
+//
+// Outside of a transaction the region is ordinary memory. Only the calling
+// thread should write to it during a transaction: writes of other threads
+// are rolled back as well.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "try_catch_guard.hpp"
+
+namespace try_catch_guard {
+namespace tracking {
+
+struct WriteTrackingStats {
+    std::uint64_t write_faults = 0;     // First writes trapped
+    std::uint64_t checkpoints = 0;
+    std::uint64_t pages_copied = 0;     // Dirty pages visited by checkpoints
+    std::uint64_t protect_calls = 0;    // mprotect() calls made by checkpoints
+    std::uint64_t protect_failures = 0; // Runs left writable and dirty because mprotect() failed
+};
+
+class WriteTrackedRegion {
+public:
+    // Maps `size` bytes of zeroed memory, rounded up to whole pages.
+    // Throws std::bad_alloc if the mapping or its range hook cannot be created.
+    explicit WriteTrackedRegion(std::size_t size);
+    ~WriteTrackedRegion();
+
+    WriteTrackedRegion(const WriteTrackedRegion&) = delete;
+    WriteTrackedRegion& operator=(const WriteTrackedRegion&) = delete;
+
+    void* data() const { return base_; }
+    std::size_t size() const { return pages_ * page_size_; }
+    std::size_t pageSize() const { return page_size_; }
+    std::size_t pageCount() const { return pages_; }
+
+    bool isDirty(std::size_t page) const
+    {
+        return (dirty_[page / 64].load(std::memory_order_relaxed) >> (page % 64)) & 1;
+    }
+
+    std::size_t dirtyPageCount() const;
+
+    // Calls visit(offset, data, bytes) for every run of consecutive dirty
+    // pages, after write-protecting the run, and returns the number of pages
+    // visited. One checkpoint at a time.
+    template <typename Visit>
+    std::size_t checkpointRuns(Visit&& visit)
+    {
+        std::size_t visited = 0;
+        std::size_t run_first = 0;
+        std::size_t run_length = 0;
+
+        auto flush = [&] {
+            if (run_length != 0)
+            {
+                protectRun(run_first, run_length);
+                visit(run_first * page_size_, static_cast<const void*>(base_ + run_first * page_size_),
+                      run_length * page_size_);
+                visited += run_length;
+                run_length = 0;
+            }
+        };
+
+        for (std::size_t word = 0; word < words_; ++word)
+        {
+            std::uint64_t bits = dirty_[word].exchange(0, std::memory_order_acq_rel);
+            if (bits == 0)
+            {
+                flush();
+                continue;
+            }
+            for (std::size_t bit = 0; bit < 64; ++bit)
+            {
+                std::size_t page = word * 64 + bit;
+                if ((bits >> bit) & 1)
+                {
+                    if (run_length == 0) {
+                        run_first = page;
+                    }
+                    ++run_length;
+                }
+                else {
+                    flush();
+                }
+            }
+        }
+        flush();
+
+        finishCheckpoint(visited);
+        return visited;
+    }
+
+    // Copies the dirty pages to the same offsets of `snapshot`, a buffer of
+    // size() bytes holding the previous checkpoint
+    std::size_t checkpoint(void* snapshot)
+    {
+        char* out = static_cast<char*>(snapshot);
+        return checkpointRuns([out](std::size_t offset, const void* data, std::size_t bytes) {
+            memcpy(out + offset, data, bytes);
+        });
+    }
+
+    WriteTrackingStats stats() const;
+
+private:
+    static FaultAction onFault(void* context, int signal, siginfo_t* info, void* ucontext);
+
+    void protectRun(std::size_t first, std::size_t count);
+    void finishCheckpoint(std::size_t visited);
+
+    char* base_;
+    std::size_t page_size_;
+    std::size_t pages_;
+    std::size_t words_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> dirty_; // One bit per page
+    std::atomic<std::uint64_t> write_faults_;
+    std::uint64_t checkpoints_;
+    std::uint64_t pages_copied_;
+    std::uint64_t protect_calls_;
+    std::uint64_t protect_failures_;
+};
+
+struct RollbackStats {
+    std::uint64_t transactions = 0;
+    std::uint64_t rollbacks = 0;      // Transactions that faulted or threw
+    std::uint64_t pages_saved = 0;    // Pages copied on their first write
+    std::uint64_t pages_restored = 0; // Pages copied back by rollbacks
+};
+
+class RollbackRegion {
+public:
+    // Maps `size` bytes of zeroed memory, rounded up to whole pages, and a
+    // shadow mapping of the same size for the saved pages (only the pages
+    // saved so far use memory). Throws std::bad_alloc on failure.
+    explicit RollbackRegion(std::size_t size);
+    ~RollbackRegion();
+
+    RollbackRegion(const RollbackRegion&) = delete;
+    RollbackRegion& operator=(const RollbackRegion&) = delete;
+
+    void* data() const { return base_; }
+    std::size_t size() const { return pages_ * page_size_; }
+    std::size_t pageSize() const { return page_size_; }
+
+    bool inTransaction() const { return active_.load(std::memory_order_relaxed); }
+
+    // Runs `block` under the default guard as a transaction: its writes to
+    // the region are kept if it returns and undone if it faults or throws,
+    // before the exception propagates. Transactions on one region do not
+    // nest (std::logic_error).
+    template <typename Block>
+    void transaction(Block&& block)
+    {
+        begin();
+        try {
+            default_guard::run(block);
+        }
+        catch (...) {
+            rollback();
+            throw;
+        }
+        commit();
+    }
+
+    RollbackStats stats() const;
+
+private:
+    static FaultAction onFault(void* context, int signal, siginfo_t* info, void* ucontext);
+
+    void begin();
+    void commit();
+    void rollback();
+
+    char* base_;
+    char* shadow_;
+    std::size_t page_size_;
+    std::size_t pages_;
+    std::size_t words_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> saved_; // One bit per page saved in this transaction
+    std::atomic<bool> active_;
+    std::atomic<std::uint64_t> pages_saved_;
+    std::uint64_t transactions_;
+    std::uint64_t rollbacks_;
+    std::uint64_t pages_restored_;
+};
+
+} // namespace tracking
+
+using tracking::WriteTrackedRegion;
+using tracking::RollbackRegion;
+
+} // namespace try_catch_guard
+
+// _try over a RollbackRegion, used with _catch
+#define _try_rollback(region) \
+    try                       \
+    { (region).transaction([&]()
+
+#endif // TRY_CATCH_GUARD_WRITE_TRACKING_HPP
@@ -0,0 +1,43 @@
+/*
+ * Helpers for the C interface tests in try_catch_guard_tests.cpp.
+ * Compiled as C to check that try_catch_guard.h is usable from C code.
+ */
+
+#include <signal.h>
+#include "try_catch_guard.h"
+
+static void writeValue(void* arg)
+{
+    *(int*)arg = 42;
+}
+
+static void dereferenceNull(void* arg)
+{
+    volatile int* ptr = (volatile int*)0;
+    (void)arg;
+    *ptr = 1;
+}
+
+/* Calls a function that writes *value; returns the status */
+int cApiCallWrite(int* value)
+{
+    return tcg_call(writeValue, value, 0);
+}
+
+/* Calls a function that faults; returns the status and fills *info */
+int cApiCallFault(tcg_fault_info* info)
+{
+    return tcg_call(dereferenceNull, 0, info);
+}
+
+/* Reads *src through tcg_safe_read(); returns the status */
+int cApiSafeRead(const void* src, long* out)
+{
+    return tcg_safe_read(out, src, sizeof(*out));
+}
+
+/* Signal number a recovered segmentation fault reports */
+int cApiSegvSignal(void)
+{
+    return SIGSEGV;
+}
@@ -0,0 +1,32 @@
+// Helpers for the cross translation unit tests in try_catch_guard_tests.cpp.
+// They live in their own translation unit so that the guards they enter share
+// the thread context with the guards of the test file only through the library.
+
+#include <functional>
+#include "try_catch_guard.hpp"
+
+// Jump buffer stack depth seen from this translation unit
+std::size_t crossTuStackDepth()
+{
+    return try_catch_guard::currentThreadContext ? try_catch_guard::currentThreadContext->jmpbuf_stack.size() : 0;
+}
+
+// Runs `inner` inside a _try entered in this translation unit; returns true if it faulted
+bool crossTuGuard(const std::function<void()>& inner)
+{
+    bool caught = false;
+    _try {
+        inner();
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        caught = true;
+    }
+    return caught;
+}
+
+// Dereferences a null pointer without a guard of its own
+void crossTuFault()
+{
+    volatile int* ptr = nullptr;
+    *ptr = 42;
+}
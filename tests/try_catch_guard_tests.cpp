@@ -2,10 +2,24 @@
 // CATCH_CONFIG_NO_POSIX_SIGNALS is defined in CMakeLists.txt
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_session.hpp>
+#include <algorithm>
 #include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
 #include <thread>
 #include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "try_catch_guard.hpp"
+#include "fault_injection.hpp"
+#include "speculate.hpp"
+#include "profiler.hpp"
+#include "write_tracking.hpp"
+#include "prefetch.hpp"
+#include "compressed_memory.hpp"
 
 // Test case for null pointer dereference
 TEST_CASE("TryCatchGuard catches null pointer dereference", "[try_catch_guard]") {
@@ -1092,3 +1106,1832 @@ TEST_CASE("MemoryGuard handles nested try blocks with multithreading", "[memory_
     // Verify that only even-numbered threads caught the outer exception
     REQUIRE(outer_exceptions_caught == (num_threads + 1) / 2);
 }
+
+// Test case for the memory footprint introspection API
+TEST_CASE("TryCatchGuard reports its per-thread and global memory footprint", "[try_catch_guard]") {
+    try_catch_guard::unregisterThreadHandler();
+    try_catch_guard::MemoryFootprint before = try_catch_guard::getMemoryFootprint();
+    
+    // The thread context fits in two cache lines; the rest of the per-thread
+    // state is the exception reserve and the last exception, on the heap
+    REQUIRE(sizeof(try_catch_guard::ThreadContext) <= 2 * 64);
+    std::size_t reserve_bytes = sizeof(try_catch_guard::InvalidMemoryAccessException);
+    REQUIRE(before.per_thread_bytes > sizeof(try_catch_guard::ThreadContext) + 2 * reserve_bytes);
+    REQUIRE(before.per_frame_bytes == sizeof(try_catch_guard::JumpBufferStack::Frame));
+    REQUIRE(before.global_bytes > 0);
+    
+    const int num_threads = 4;
+    std::atomic<int> registered(0);
+    std::atomic<bool> release(false);
+    std::vector<std::thread> threads;
+    
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&]() {
+            _try {
+                registered++;
+            }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+            }
+            
+            while (!release) {
+                std::this_thread::yield();
+            }
+            
+            // Threads exit without unregistering; their contexts are removed at exit
+        });
+    }
+    
+    while (registered != num_threads) {
+        std::this_thread::yield();
+    }
+    
+    try_catch_guard::MemoryFootprint during = try_catch_guard::getMemoryFootprint();
+    REQUIRE(during.registered_threads == before.registered_threads + num_threads);
+    REQUIRE(during.total_bytes ==
+            during.global_bytes + during.per_thread_bytes * during.registered_threads + during.undo_log_bytes);
+    
+    release = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    try_catch_guard::MemoryFootprint after = try_catch_guard::getMemoryFootprint();
+    REQUIRE(after.registered_threads == before.registered_threads);
+}
+
+// Defined in try_catch_guard_cross_tu.cpp
+std::size_t crossTuStackDepth();
+bool crossTuGuard(const std::function<void()>& inner);
+void crossTuFault();
+
+// Test case for guards nested across translation units
+TEST_CASE("TryCatchGuard nests guards across translation units", "[try_catch_guard]") {
+    bool outer_caught = false;
+    bool inner_caught = false;
+    std::size_t inner_depth = 0;
+    
+    // Depths are relative to the stack below the outer guard
+    std::size_t base_depth = 0;
+    
+    _try {
+        base_depth = try_catch_guard::currentThreadContext->jmpbuf_stack.size() - 1;
+        REQUIRE(crossTuStackDepth() == base_depth + 1);
+        
+        // The inner guard is entered in the other translation unit and
+        // recovers a fault raised from this one
+        inner_caught = crossTuGuard([&]() {
+            inner_depth = crossTuStackDepth();
+            int* ptr = nullptr;
+            *ptr = 1;
+        });
+        
+        REQUIRE(try_catch_guard::currentThreadContext->jmpbuf_stack.size() == base_depth + 1);
+        
+        // A fault raised in the other translation unit unwinds to this guard
+        crossTuFault();
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        outer_caught = true;
+    }
+    
+    REQUIRE(inner_depth == base_depth + 2);
+    REQUIRE(inner_caught);
+    REQUIRE(outer_caught);
+    REQUIRE(crossTuStackDepth() == base_depth);
+    REQUIRE(try_catch_guard::currentThreadContext->jmpbuf_stack.size() == base_depth);
+}
+
+// Defined in try_catch_guard_c_api.c
+extern "C" {
+#include "try_catch_guard.h"
+int cApiCallWrite(int* value);
+int cApiCallFault(tcg_fault_info* info);
+int cApiSafeRead(const void* src, long* out);
+int cApiSegvSignal(void);
+}
+
+// Test case for guarded calls through the C interface
+TEST_CASE("TryCatchGuard C interface reports faults as status codes", "[try_catch_guard][c_api]") {
+    int value = 0;
+    REQUIRE(cApiCallWrite(&value) == TCG_OK);
+    REQUIRE(value == 42);
+    
+    tcg_stats before;
+    tcg_get_stats(&before);
+    
+    tcg_fault_info info = { 0, reinterpret_cast<void*>(1) };
+    REQUIRE(cApiCallFault(&info) == TCG_FAULT);
+    REQUIRE(info.signal == cApiSegvSignal());
+    REQUIRE(info.address == nullptr);
+    
+    tcg_stats after;
+    tcg_get_stats(&after);
+    REQUIRE(after.recovered_faults >= before.recovered_faults + 1);
+    REQUIRE(after.registered_threads >= 1);
+    REQUIRE(after.per_thread_bytes > 0);
+    
+    // A C++ exception thrown by the guarded function does not cross the interface
+    auto throwing = [](void*) { throw std::runtime_error("not across the C boundary"); };
+    REQUIRE(tcg_call(throwing, nullptr, nullptr) == TCG_CPP_EXCEPTION);
+    
+    // A fault left uncaught by a nested _try is reported as a fault
+    auto nested = [](void*) {
+        try_catch_guard::segvTryBlock([] {
+            int* ptr = nullptr;
+            *ptr = 1;
+        });
+    };
+    REQUIRE(tcg_call(nested, nullptr, &info) == TCG_FAULT);
+    REQUIRE(info.signal == SIGSEGV);
+    
+    // It carries the signal that the nested guard recovered
+    auto nested_fpe = [](void*) {
+        try_catch_guard::basic_guard<try_catch_guard::policy::catch_signals<SIGSEGV, SIGFPE>>::run([] {
+            raise(SIGFPE);
+        });
+    };
+    REQUIRE(tcg_call(nested_fpe, nullptr, &info) == TCG_FAULT);
+    REQUIRE(info.signal == SIGFPE);
+    REQUIRE(tcg_call(nullptr, nullptr, nullptr) == TCG_INVALID_ARGUMENT);
+    REQUIRE(std::string(tcg_status_string(TCG_FAULT)) == "invalid memory access");
+}
+
+// Test case for the safe read primitive
+TEST_CASE("TryCatchGuard safe read copies readable memory and rejects invalid memory", "[try_catch_guard][c_api]") {
+    long source = 1234;
+    long copy = 0;
+    REQUIRE(cApiSafeRead(&source, &copy) == TCG_OK);
+    REQUIRE(copy == 1234);
+    
+    REQUIRE(cApiSafeRead(reinterpret_cast<const void*>(16), &copy) == TCG_FAULT);
+    REQUIRE(tcg_safe_read(nullptr, &source, sizeof(source)) == TCG_INVALID_ARGUMENT);
+    
+    // The C++ primitive behaves the same way
+    REQUIRE(try_catch_guard::safeRead(&copy, &source, sizeof(source)));
+    REQUIRE_FALSE(try_catch_guard::safeRead(&copy, reinterpret_cast<const void*>(16), sizeof(copy)));
+}
+
+namespace {
+
+int callbackFaults = 0;
+void* callbackAddress = reinterpret_cast<void*>(1);
+
+void recordFault(const try_catch_guard::FaultInfo& fault)
+{
+    ++callbackFaults;
+    callbackAddress = fault.address;
+}
+
+void incrementCounter(void* argument)
+{
+    ++*static_cast<int*>(argument);
+}
+
+} // namespace
+
+// Test case for the unwind policies of basic_guard
+TEST_CASE("basic_guard reports faults through its unwind policy", "[try_catch_guard][basic_guard]") {
+    using namespace try_catch_guard;
+    
+    // Expected-like result instead of an exception
+    GuardResult ok = basic_guard<policy::result_on_fault>::run([] {});
+    REQUIRE(ok);
+    REQUIRE_FALSE(ok.faulted());
+    
+    GuardResult faulted = basic_guard<policy::result_on_fault>::run([] {
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(faulted.faulted());
+    REQUIRE(faulted.signal == SIGSEGV);
+    REQUIRE(faulted.address == nullptr);
+    
+    // Callback, then normal return
+    callbackFaults = 0;
+    basic_guard<policy::callback_on_fault<recordFault>>::run([] {
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(callbackFaults == 1);
+    REQUIRE(callbackAddress == nullptr);
+    
+    // The default policy throws, like _try
+    bool caught = false;
+    try {
+        default_guard::run([] {
+            int* ptr = nullptr;
+            *ptr = 1;
+        });
+    }
+    catch (const InvalidMemoryAccessException&) {
+        caught = true;
+    }
+    REQUIRE(caught);
+}
+
+// Test case for the stats, cleanup and signal policies of basic_guard
+TEST_CASE("basic_guard counts, runs fault cleanups and catches extra signals", "[try_catch_guard][basic_guard]") {
+    using namespace try_catch_guard;
+    using CountingGuard = basic_guard<policy::result_on_fault, policy::thread_stats>;
+    
+    CountingGuard::run([] {});
+    GuardStats before = getThreadGuardStats();
+    CountingGuard::run([] {});
+    CountingGuard::run([] {
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    GuardStats after = getThreadGuardStats();
+    REQUIRE(after.entries == before.entries + 2);
+    REQUIRE(after.faults == before.faults + 1);
+    
+    // Cleanups run in reverse order on a fault only
+    using CleanupGuard = basic_guard<policy::result_on_fault, policy::fault_cleanups>;
+    int released = 0;
+    GuardResult clean = CleanupGuard::run([&] {
+        REQUIRE(addFaultCleanup(incrementCounter, &released));
+    });
+    REQUIRE(clean);
+    REQUIRE(released == 0);
+    
+    GuardResult dirty = CleanupGuard::run([&] {
+        addFaultCleanup(incrementCounter, &released);
+        addFaultCleanup(incrementCounter, &released);
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(dirty.faulted());
+    REQUIRE(released == 2);
+    REQUIRE(currentThreadContext->fault_cleanups == nullptr);
+    REQUIRE_FALSE(addFaultCleanup(incrementCounter, &released));
+    
+    // Signals other than SIGSEGV are installed by the signal policy
+    using FpeGuard = basic_guard<policy::catch_signals<SIGSEGV, SIGFPE>, policy::result_on_fault>;
+    GuardResult fpe = FpeGuard::run([] { raise(SIGFPE); });
+    REQUIRE(fpe.signal == SIGFPE);
+}
+
+namespace {
+
+template <typename Context>
+[[noreturn]] __attribute__((noinline)) void resumeWith(Context& ctx, int value)
+{
+    try_catch_guard::context::resumeContext(ctx, value);
+}
+
+} // namespace
+
+// Test case for the context-capture backends
+TEST_CASE("Every context-capture backend resumes with the given value", "[try_catch_guard][context]") {
+    using namespace try_catch_guard::context;
+    
+    SetjmpContext setjmp_ctx;
+    volatile int setjmp_passes = 0;
+    int setjmp_value = TRY_CATCH_GUARD_SETJMP_CAPTURE(setjmp_ctx);
+    if (setjmp_passes++ == 0) {
+        resumeWith(setjmp_ctx, SIGSEGV);
+    }
+    REQUIRE(setjmp_value == SIGSEGV);
+    
+    SigsetjmpContext sigsetjmp_ctx;
+    volatile int sigsetjmp_passes = 0;
+    int sigsetjmp_value = TRY_CATCH_GUARD_SIGSETJMP_CAPTURE(sigsetjmp_ctx);
+    if (sigsetjmp_passes++ == 0) {
+        resumeWith(sigsetjmp_ctx, SIGBUS);
+    }
+    REQUIRE(sigsetjmp_value == SIGBUS);
+    
+    BuiltinContext builtin_ctx;
+    volatile int builtin_passes = 0;
+    int builtin_value = TRY_CATCH_GUARD_BUILTIN_CAPTURE(builtin_ctx);
+    if (builtin_passes++ == 0) {
+        resumeWith(builtin_ctx, SIGFPE);
+    }
+    REQUIRE(builtin_value == SIGFPE);
+    
+#if TRY_CATCH_GUARD_HAS_ASM_CONTEXT
+    AsmContext asm_ctx;
+    volatile int asm_passes = 0;
+    int asm_value = TRY_CATCH_GUARD_ASM_CAPTURE(asm_ctx);
+    if (asm_passes++ == 0) {
+        resumeWith(asm_ctx, 0); // 0 resumes as 1, like longjmp
+    }
+    REQUIRE(asm_value == 1);
+#endif
+}
+
+// Stress test: C++ exceptions escaping guarded blocks, interleaved with faults,
+// must leave the jump buffer stack, the registry and the library's memory
+// exactly as they were
+TEST_CASE("TryCatchGuard keeps its frame stack consistent under interleaved throws and faults", "[try_catch_guard][stress]") {
+    using ResultGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+    
+    // Up to two million iterations, half of them faulting, within a time
+    // budget that keeps the suite usable under the sanitizers
+    const std::size_t max_iterations = 2000000;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    std::size_t iterations = 0;
+    std::size_t throws_caught = 0;
+    std::size_t faults_caught = 0;
+    std::size_t inconsistent = 0;
+    
+    // Attach the thread and start from an empty stack
+    _try {
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+    }
+    std::size_t base_depth = try_catch_guard::currentThreadContext->jmpbuf_stack.size();
+    REQUIRE(base_depth == 0);
+    try_catch_guard::MemoryFootprint footprint_before = try_catch_guard::getMemoryFootprint();
+    std::uint64_t recovered_before = try_catch_guard::getRecoveredFaultCount();
+    
+    for (std::size_t i = 0; i < max_iterations; ++i, ++iterations) {
+        if (i % 4096 == 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        switch (i % 4) {
+        case 0:
+            // A C++ exception escapes the block
+            try {
+                _try {
+                    throw std::runtime_error("escaping");
+                }
+                _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                }
+            }
+            catch (const std::runtime_error&) {
+                ++throws_caught;
+            }
+            break;
+        case 1:
+            // A fault
+            _try {
+                int* ptr = nullptr;
+                *ptr = 1;
+            }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                ++faults_caught;
+            }
+            break;
+        case 2:
+            // An exception escapes an inner guard, then the outer guard faults
+            _try {
+                try {
+                    _try {
+                        throw std::logic_error("inner");
+                    }
+                    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                    }
+                }
+                catch (const std::logic_error&) {
+                    ++throws_caught;
+                }
+                int* ptr = nullptr;
+                *ptr = 1;
+            }
+            _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+                ++faults_caught;
+            }
+            break;
+        default:
+            // An exception escapes a guard with a non-throwing unwind policy
+            try {
+                ResultGuard::run([] { throw 42; });
+            }
+            catch (int) {
+                ++throws_caught;
+            }
+            break;
+        }
+        
+        if (try_catch_guard::currentThreadContext->jmpbuf_stack.size() != base_depth) {
+            ++inconsistent;
+        }
+    }
+    
+    REQUIRE(iterations >= 4096);
+    REQUIRE(inconsistent == 0);
+    // The loop stops on a multiple of 4096, so every round of four is complete
+    REQUIRE(throws_caught == iterations / 4 * 3);
+    REQUIRE(faults_caught == iterations / 4 * 2);
+    REQUIRE(try_catch_guard::getRecoveredFaultCount() - recovered_before == faults_caught);
+    REQUIRE(try_catch_guard::currentThreadContext->jmpbuf_stack.empty());
+    
+    // Nothing accumulated: same registration, same footprint, and one
+    // exception reserve again after the next guard refills it
+    _try {
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+    }
+    REQUIRE(try_catch_guard::currentThreadContext->exception_reserve != nullptr);
+    try_catch_guard::MemoryFootprint footprint_after = try_catch_guard::getMemoryFootprint();
+    REQUIRE(footprint_after.registered_threads == footprint_before.registered_threads);
+    REQUIRE(footprint_after.undo_log_bytes == footprint_before.undo_log_bytes);
+    REQUIRE(footprint_after.total_bytes == footprint_before.total_bytes);
+}
+
+namespace {
+
+struct HookRecord {
+    int calls = 0;
+    int last_signal = 0;
+    void* last_address = nullptr;
+    try_catch_guard::FaultAction action = try_catch_guard::FaultAction::Continue;
+};
+
+try_catch_guard::FaultAction recordingHook(void* context, int signal, siginfo_t* info, void*)
+{
+    HookRecord* record = static_cast<HookRecord*>(context);
+    ++record->calls;
+    record->last_signal = signal;
+    record->last_address = info ? info->si_addr : nullptr;
+    return record->action;
+}
+
+// Makes the faulting page writable and retries the access
+try_catch_guard::FaultAction unprotectHook(void* context, int, siginfo_t*, void*)
+{
+    mprotect(context, static_cast<std::size_t>(sysconf(_SC_PAGESIZE)), PROT_READ | PROT_WRITE);
+    return try_catch_guard::FaultAction::Resume;
+}
+
+volatile sig_atomic_t previousHandlerCalls = 0;
+
+void previousUsr1Handler(int)
+{
+    previousHandlerCalls = previousHandlerCalls + 1;
+}
+
+} // namespace
+
+// Test case for the per-thread and per-guard fault hooks
+TEST_CASE("Fault hooks record, resume, unwind and chain faults", "[try_catch_guard][hooks]") {
+    using namespace try_catch_guard;
+    using ResultGuard = basic_guard<policy::result_on_fault>;
+    
+    // Record-and-continue on the thread hook: the guard still unwinds
+    HookRecord thread_record;
+    setThreadFaultHook(recordingHook, &thread_record);
+    GuardResult recorded = ResultGuard::run([] {
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(recorded.faulted());
+    REQUIRE(thread_record.calls == 1);
+    REQUIRE(thread_record.last_signal == SIGSEGV);
+    REQUIRE(thread_record.last_address == nullptr);
+    
+    // A guard hook runs first; Unwind stops before the thread hook
+    HookRecord guard_record;
+    guard_record.action = FaultAction::Unwind;
+    GuardResult unwound = ResultGuard::run([&] {
+        REQUIRE(setGuardFaultHook(recordingHook, &guard_record));
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(unwound.faulted());
+    REQUIRE(guard_record.calls == 1);
+    REQUIRE(thread_record.calls == 1);
+    
+    // The guard hook went away with its guard
+    ResultGuard::run([] {
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(guard_record.calls == 1);
+    REQUIRE(thread_record.calls == 2);
+    setThreadFaultHook(nullptr, nullptr);
+    
+    // Resume: the hook repairs the page and the store is retried without unwinding
+    long page_size = sysconf(_SC_PAGESIZE);
+    void* page = mmap(nullptr, page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(page != MAP_FAILED);
+    GuardResult resumed = ResultGuard::run([&] {
+        setGuardFaultHook(unprotectHook, page);
+        static_cast<volatile int*>(page)[0] = 7;
+    });
+    REQUIRE_FALSE(resumed.faulted());
+    REQUIRE(static_cast<int*>(page)[0] == 7);
+    munmap(page, page_size);
+    
+    // Chain: the signal goes to the handler installed before the library's
+    struct sigaction previous;
+    memset(&previous, 0, sizeof(previous));
+    previous.sa_handler = previousUsr1Handler;
+    sigemptyset(&previous.sa_mask);
+    struct sigaction saved;
+    sigaction(SIGUSR1, &previous, &saved);
+    installSignalHandler(SIGUSR1);
+    
+    HookRecord chain_record;
+    chain_record.action = FaultAction::Chain;
+    GuardResult chained = ResultGuard::run([&] {
+        setGuardFaultHook(recordingHook, &chain_record);
+        raise(SIGUSR1);
+    });
+    REQUIRE_FALSE(chained.faulted());
+    REQUIRE(chain_record.calls == 1);
+    REQUIRE(previousHandlerCalls == 1);
+    
+    // Outside of a guard the signal is chained as well
+    raise(SIGUSR1);
+    REQUIRE(previousHandlerCalls == 2);
+
+    // Later tests must not inherit the library's SIGUSR1 handler
+    sigaction(SIGUSR1, &saved, nullptr);
+}
+
+// Runs `count` guards around the "tests.pattern" fault point and records which faulted
+static std::vector<bool> injectionPattern(int count)
+{
+    using ResultGuard = try_catch_guard::basic_guard<try_catch_guard::policy::result_on_fault>;
+    std::vector<bool> pattern;
+    for (int i = 0; i < count; ++i) {
+        try_catch_guard::GuardResult result = ResultGuard::run([] {
+            TRY_CATCH_GUARD_FAULT_POINT("tests.pattern");
+        });
+        pattern.push_back(result.faulted());
+    }
+    return pattern;
+}
+
+// Test case for seeded fault injection with both delivery modes
+TEST_CASE("Fault injection is deterministic, per site and recoverable", "[try_catch_guard][injection]") {
+    using namespace try_catch_guard;
+    using ResultGuard = basic_guard<policy::result_on_fault>;
+    
+    // Configured before the point is first reached
+    injection::setSiteProbability("tests.pattern", 0.25);
+    
+    // The same seed and stream inject the same faults
+    injection::enable(7, injection::Delivery::Simulated);
+    injection::setThreadStream(0);
+    std::vector<bool> first = injectionPattern(4000);
+    injection::enable(7, injection::Delivery::Simulated);
+    injection::setThreadStream(0);
+    std::vector<bool> second = injectionPattern(4000);
+    REQUIRE(first == second);
+    
+    injection::enable(8, injection::Delivery::Simulated);
+    injection::setThreadStream(0);
+    REQUIRE(injectionPattern(4000) != first);
+    
+    // The observed rate follows the probability
+    size_t injected = 0;
+    for (bool faulted : first) {
+        injected += faulted ? 1 : 0;
+    }
+    REQUIRE(injected > 800);
+    REQUIRE(injected < 1200);
+    
+    // Simulated faults report the site, signal faults go through the handler
+    uint64_t recovered_before = getRecoveredFaultCount();
+    injection::setSiteProbability("tests.pattern", 1.0);
+    GuardResult simulated = ResultGuard::run([] {
+        TRY_CATCH_GUARD_FAULT_POINT("tests.pattern");
+        FAIL("Expected an injected fault");
+    });
+    REQUIRE(simulated.signal == SIGSEGV);
+    REQUIRE(simulated.address != nullptr);
+    
+    injection::enable(7, injection::Delivery::Signal);
+    HookRecord thread_record;
+    thread_record.action = FaultAction::Continue;
+    setThreadFaultHook(recordingHook, &thread_record);
+    bool caught = false;
+    _try {
+        TRY_CATCH_GUARD_FAULT_POINT("tests.pattern");
+        FAIL("Expected an injected fault");
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        caught = true;
+    }
+    setThreadFaultHook(nullptr, nullptr);
+    REQUIRE(caught);
+    REQUIRE(thread_record.calls == 1);
+    REQUIRE(getRecoveredFaultCount() == recovered_before + 2);
+    
+    // Nothing is injected outside a guard or at a disabled site
+    TRY_CATCH_GUARD_FAULT_POINT("tests.pattern");
+    injection::setSiteEnabled("tests.pattern", false);
+    std::vector<bool> disabled_site = injectionPattern(100);
+    REQUIRE(std::count(disabled_site.begin(), disabled_site.end(), true) == 0);
+    
+    bool found = false;
+    for (const injection::SiteStats& site : injection::siteStats()) {
+        if (site.name == "tests.pattern") {
+            found = true;
+            REQUIRE_FALSE(site.enabled);
+            REQUIRE(site.probability == 1.0);
+            REQUIRE(site.evaluations == 3 * 4000 + 2);
+            REQUIRE(site.injected >= injected * 2 + 2);
+        }
+    }
+    REQUIRE(found);
+    
+    injection::disable();
+    injection::setSiteProbability("tests.pattern", 1.0);
+    std::vector<bool> disabled_injection = injectionPattern(100);
+    REQUIRE(std::count(disabled_injection.begin(), disabled_injection.end(), true) == 0);
+}
+
+namespace {
+
+// Property-based nesting tests: random guarded programs are executed for real
+// and by a reference model, and both must produce the same event trace.
+
+enum class NestAction { None, Fault, Throw };
+
+// One nesting level: an action before entering the next level, whether the
+// level catches C++ exceptions escaping the next level, and an action after it
+struct NestLevel {
+    NestAction before = NestAction::None;
+    bool catches_throw = false;
+    NestAction after = NestAction::None;
+};
+
+enum NestEvent : int {
+    NestEnter = 0,
+    NestLeave = 1,
+    NestFaultCaught = 2,
+    NestThrowCaught = 3,
+    NestBadDepth = 4
+};
+
+int nestEvent(std::size_t level, NestEvent event)
+{
+    return static_cast<int>(level) * 8 + event;
+}
+
+struct NestException {
+    std::size_t level;
+};
+
+// About two faults, two throws and one catching level per program, whatever
+// its depth, so that deep programs do not stop at their first levels
+std::vector<NestLevel> randomNestProgram(std::mt19937_64& rng, std::size_t depth)
+{
+    std::uniform_int_distribution<std::size_t> slot(0, 2 * depth - 1);
+    auto action = [&] {
+        std::size_t p = slot(rng);
+        return p < 2 ? NestAction::Fault : (p < 4 ? NestAction::Throw : NestAction::None);
+    };
+    
+    std::vector<NestLevel> program(depth);
+    for (NestLevel& level : program) {
+        level.before = action();
+        level.catches_throw = slot(rng) < 2;
+        level.after = action();
+    }
+    return program;
+}
+
+// Reference model; returns true when a C++ exception escapes `level`
+bool modelNestLevel(const std::vector<NestLevel>& program, std::size_t level, std::vector<int>& trace)
+{
+    const NestLevel& current = program[level];
+    trace.push_back(nestEvent(level, NestEnter));
+    
+    for (int step = 0; step < 2; ++step) {
+        NestAction action = step == 0 ? current.before : current.after;
+        if (action == NestAction::Fault) {
+            // A fault unwinds to the guard of this level, which returns normally
+            trace.push_back(nestEvent(level, NestFaultCaught));
+            return false;
+        }
+        if (action == NestAction::Throw) {
+            return true;
+        }
+        if (step == 0 && level + 1 < program.size() && modelNestLevel(program, level + 1, trace)) {
+            if (!current.catches_throw) {
+                return true;
+            }
+            trace.push_back(nestEvent(level, NestThrowCaught));
+        }
+    }
+    
+    trace.push_back(nestEvent(level, NestLeave));
+    return false;
+}
+
+void runNestAction(NestAction action, std::size_t level)
+{
+    if (action == NestAction::Fault) {
+        volatile int* ptr = nullptr;
+        *ptr = static_cast<int>(level);
+    }
+    if (action == NestAction::Throw) {
+        throw NestException{ level };
+    }
+}
+
+// Real execution: one _try per level, checking the frame stack depth on entry
+void runNestLevel(const std::vector<NestLevel>& program, std::size_t level, std::size_t base_depth,
+                  std::vector<int>& trace, std::size_t& reached)
+{
+    const NestLevel& current = program[level];
+    
+    _try {
+        trace.push_back(nestEvent(level, NestEnter));
+        if (try_catch_guard::currentThreadContext->jmpbuf_stack.size() != base_depth + level + 1) {
+            trace.push_back(nestEvent(level, NestBadDepth));
+        }
+        reached = std::max(reached, level + 1);
+        
+        runNestAction(current.before, level);
+        if (level + 1 < program.size()) {
+            if (current.catches_throw) {
+                try {
+                    runNestLevel(program, level + 1, base_depth, trace, reached);
+                }
+                catch (const NestException&) {
+                    trace.push_back(nestEvent(level, NestThrowCaught));
+                }
+            } else {
+                runNestLevel(program, level + 1, base_depth, trace, reached);
+            }
+        }
+        runNestAction(current.after, level);
+        
+        trace.push_back(nestEvent(level, NestLeave));
+    }
+    _catch(try_catch_guard::InvalidMemoryAccessException, e) {
+        trace.push_back(nestEvent(level, NestFaultCaught));
+    }
+}
+
+struct NestRunResult {
+    std::size_t programs = 0;
+    std::size_t mismatches = 0;
+    std::size_t stack_leaks = 0;
+    std::size_t max_depth = 0; // Deepest level actually entered
+    std::uint64_t first_bad_seed = 0;
+};
+
+NestRunResult runRandomNestPrograms(std::uint64_t seed, std::size_t count, std::size_t max_depth)
+{
+    NestRunResult result;
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<std::size_t> depth_dist(1, max_depth);
+    
+    _try {} _catch(try_catch_guard::InvalidMemoryAccessException, e) {}
+    std::size_t base_depth = try_catch_guard::currentThreadContext->jmpbuf_stack.size();
+    
+    for (std::size_t i = 0; i < count; ++i) {
+        // Every program has its own seed so a failure can be replayed alone
+        std::uint64_t program_seed = rng();
+        std::mt19937_64 program_rng(program_seed);
+        std::size_t depth = i == 0 ? max_depth : depth_dist(program_rng);
+        std::vector<NestLevel> program = randomNestProgram(program_rng, depth);
+        if (i == 0) {
+            // The first program always reaches the maximum depth
+            for (NestLevel& level : program) {
+                level.before = NestAction::None;
+            }
+        }
+        
+        std::vector<int> expected;
+        bool expected_escape = modelNestLevel(program, 0, expected);
+        
+        std::vector<int> actual;
+        std::size_t reached = 0;
+        bool escaped = false;
+        try {
+            runNestLevel(program, 0, base_depth, actual, reached);
+        }
+        catch (const NestException&) {
+            escaped = true;
+        }
+        
+        ++result.programs;
+        result.max_depth = std::max(result.max_depth, reached);
+        if (actual != expected || escaped != expected_escape) {
+            if (result.mismatches++ == 0) {
+                result.first_bad_seed = program_seed;
+            }
+        }
+        if (try_catch_guard::currentThreadContext->jmpbuf_stack.size() != base_depth) {
+            ++result.stack_leaks;
+        }
+    }
+    
+    return result;
+}
+
+} // namespace
+
+// Property-based test: random programs of nested guards up to 1000 levels deep,
+// with faults and C++ throws at random levels, on several threads at once
+TEST_CASE("Random deeply nested guarded programs match the reference model", "[try_catch_guard][nesting][property]") {
+    const std::size_t max_depth = 1000;
+    const std::size_t programs_per_thread = 200;
+    const unsigned thread_count = 4;
+    
+    std::vector<NestRunResult> results(thread_count);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&results, t, programs_per_thread, max_depth] {
+            results[t] = runRandomNestPrograms(0x6E657374ULL + t, programs_per_thread, max_depth);
+            try_catch_guard::unregisterThreadHandler();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    for (const NestRunResult& result : results) {
+        INFO("first failing program seed: " << result.first_bad_seed);
+        REQUIRE(result.programs == programs_per_thread);
+        REQUIRE(result.max_depth == max_depth);
+        REQUIRE(result.mismatches == 0);
+        REQUIRE(result.stack_leaks == 0);
+    }
+}
+
+// Test case for the per-thread exception reserve used on the fault path
+TEST_CASE("Faults are thrown from the thread's exception reserve", "[try_catch_guard][reserve]") {
+    using namespace try_catch_guard;
+    
+    // The exception object is the reserve allocated before the fault
+    void* reserve = nullptr;
+    const void* thrown = nullptr;
+    _try {
+        reserve = currentThreadContext->exception_reserve;
+        int* ptr = nullptr;
+        *ptr = 1;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        thrown = &e;
+        REQUIRE(std::string(e.what()) == "Invalid null pointer access exception");
+    }
+    REQUIRE(reserve != nullptr);
+    REQUIRE(thrown == reserve);
+    REQUIRE(currentThreadContext->exception_reserve == nullptr);
+    
+    // The first guard after the recovery refills it
+    _try {
+        REQUIRE(currentThreadContext->exception_reserve != nullptr);
+    }
+    _catch(InvalidMemoryAccessException, e) {
+    }
+    
+    // An exception the program keeps outlives later refills
+    std::exception_ptr saved;
+    _try {
+        *reinterpret_cast<volatile int*>(0x1234) = 1;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        saved = std::current_exception();
+    }
+    for (int i = 0; i < 3; ++i) {
+        _try {
+            int* ptr = nullptr;
+            *ptr = 1;
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+    }
+    try {
+        std::rethrow_exception(saved);
+    }
+    catch (const InvalidMemoryAccessException& e) {
+        REQUIRE(std::string(e.what()) == "Invalid memory access exception at address (0x1234)");
+    }
+    
+    // A fault inside a handler still gets a reserved exception
+    bool inner_caught = false;
+    _try {
+        int* ptr = nullptr;
+        *ptr = 1;
+    }
+    _catch(InvalidMemoryAccessException, outer) {
+        _try {
+            int* ptr = nullptr;
+            *ptr = 2;
+        }
+        _catch(InvalidMemoryAccessException, inner) {
+            inner_caught = &inner != &outer;
+        }
+    }
+    REQUIRE(inner_caught);
+    
+    // Messages longer than the buffer are truncated
+    std::string long_message(InvalidMemoryAccessException::messageCapacity * 2, 'x');
+    InvalidMemoryAccessException truncated(long_message);
+    REQUIRE(std::strlen(truncated.what()) == InvalidMemoryAccessException::messageCapacity - 1);
+}
+
+namespace {
+
+// Destroyed after the thread's context when constructed before its first guard
+struct LateGuardUser {
+    std::atomic<int>* outcome = nullptr;
+    
+    ~LateGuardUser()
+    {
+        using namespace try_catch_guard;
+        bool caught = false;
+        _try {
+            int* ptr = nullptr;
+            *ptr = 1;
+        }
+        _catch(InvalidMemoryAccessException, e) {
+            caught = true;
+        }
+        
+        int value = 1;
+        bool undone = false;
+        _try_tx {
+            tx_write(&value, 2);
+            int* ptr = nullptr;
+            *ptr = 1;
+        }
+        _catch(InvalidMemoryAccessException, e) {
+            undone = value == 1;
+        }
+        outcome->store(caught && undone ? 1 : 2);
+    }
+};
+
+thread_local LateGuardUser lateGuardUser;
+
+} // namespace
+
+// Test case for guards entered after the thread's context was destroyed
+TEST_CASE("Guards in late thread_local destructors attach again and still recover", "[try_catch_guard][reserve]") {
+    using namespace try_catch_guard;
+    
+    std::size_t registered = 0;
+    {
+        std::lock_guard<std::mutex> lock(getHandlersMutex());
+        registered = getThreadRegistry().count;
+    }
+    
+    std::atomic<int> outcome(0);
+    std::thread worker([&] {
+        lateGuardUser.outcome = &outcome; // Constructed before the context
+        _try {
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+        _try_tx {
+            tx_write(&registered, registered);
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+    });
+    worker.join();
+    REQUIRE(outcome.load() == 1);
+    
+    // The context attached again is not left in the registry
+    std::lock_guard<std::mutex> lock(getHandlersMutex());
+    REQUIRE(getThreadRegistry().count == registered);
+}
+
+namespace {
+
+struct StackProbe {
+    const char* handler_stack = nullptr;
+};
+
+try_catch_guard::FaultAction probeStackHook(void* context, int, siginfo_t*, void*)
+{
+    char local = 0;
+    static_cast<StackProbe*>(context)->handler_stack = &local;
+    return try_catch_guard::FaultAction::Continue;
+}
+
+
+} // namespace
+
+// Test case for the low-jitter mode; it stays enabled for the rest of the process
+TEST_CASE("Low-jitter mode pins the fault path and runs handlers on an alternate stack", "[try_catch_guard][low_jitter]") {
+    using namespace try_catch_guard;
+    
+    LowJitterOptions options;
+    options.alternate_stack_size = 128 * 1024;
+    // Locking may fail under a small RLIMIT_MEMLOCK; the ranges are pre-touched anyway
+    bool locked = enableLowJitterMode(options);
+    LowJitterStatus status = getLowJitterStatus();
+    REQUIRE(status.enabled);
+    REQUIRE(status.handler_text_bytes > 0);
+    REQUIRE(status.all_locked == locked);
+    if (locked) {
+        REQUIRE(status.locked_bytes >= status.handler_text_bytes);
+    }
+    
+    // A thread registered afterwards gets the alternate stack and recovers on it
+    bool has_stack = false;
+    bool on_stack = false;
+    bool caught = false;
+    std::thread worker([&] {
+        _try {
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+        stack_t current;
+        sigaltstack(nullptr, &current);
+        has_stack = !(current.ss_flags & SS_DISABLE) && current.ss_size >= options.alternate_stack_size;
+        
+        StackProbe probe;
+        setThreadFaultHook(probeStackHook, &probe);
+        _try {
+            volatile int* volatile ptr = nullptr;
+            *ptr = 1;
+        }
+        _catch(InvalidMemoryAccessException, e) {
+            caught = true;
+        }
+        setThreadFaultHook(nullptr, nullptr);
+        
+        const char* stack_begin = static_cast<const char*>(current.ss_sp);
+        on_stack = probe.handler_stack >= stack_begin && probe.handler_stack < stack_begin + current.ss_size;
+        unregisterThreadHandler();
+    });
+    worker.join();
+    
+    REQUIRE(has_stack);
+    REQUIRE(caught);
+    REQUIRE(on_stack);
+    
+    // Every recovery throws from a locked reserve, not only the first one
+    if (locked)
+    {
+        _try {
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+        for (int round = 0; round < 2; ++round)
+        {
+            std::size_t reserves = getLowJitterStatus().locked_reserves;
+            _try {
+                volatile int* volatile ptr = nullptr;
+                *ptr = 1;
+            }
+            _catch(InvalidMemoryAccessException, e) {
+            }
+            // The next guard refills the reserve the fault consumed
+            _try {
+            }
+            _catch(InvalidMemoryAccessException, e) {
+            }
+            REQUIRE(getLowJitterStatus().locked_reserves == reserves + 1);
+        }
+    }
+    
+    // Enabling again is a no-op
+    REQUIRE(enableLowJitterMode(options) == locked);
+}
+
+namespace {
+
+// Sums `count` values, trusting the pointer
+int sumUnchecked(const int* values, int count)
+{
+    int sum = 0;
+    for (int i = 0; i < count; ++i) {
+        sum += *(volatile const int*)&values[i];
+    }
+    return sum;
+}
+
+} // namespace
+
+// Test case for speculate(): fallback on faults and pinning of failing sites
+TEST_CASE("Speculation falls back on faults and pins failing sites", "[try_catch_guard][speculate]") {
+    using namespace try_catch_guard;
+    
+    const int values[] = { 1, 2, 3, 4 };
+    int fast_runs = 0;
+    int slow_runs = 0;
+    auto sum = [&](const int* data) {
+        return speculate(
+            [&] { ++fast_runs; return sumUnchecked(data, 4); },
+            [&] { ++slow_runs; return data ? sumUnchecked(data, 4) : -1; });
+    };
+    
+    // The fast result is used when it does not fault, the slow one otherwise
+    REQUIRE(sum(values) == 10);
+    REQUIRE(sum(nullptr) == -1);
+    REQUIRE(fast_runs == 2);
+    REQUIRE(slow_runs == 1);
+    
+    // void fast and slow paths
+    int writes = 0;
+    speculate([&] { volatile int* volatile ptr = nullptr; *ptr = 1; ++writes; }, [&] { writes += 10; });
+    REQUIRE(writes == 10);
+    
+    // C++ exceptions from the fast path propagate and are not faults
+    speculation::Site throwing("test.speculate.throw");
+    REQUIRE_THROWS_AS(speculation::speculate(throwing, [] () -> int { throw std::runtime_error("fast"); }, [] { return 0; }),
+                      std::runtime_error);
+    REQUIRE(throwing.pinned() == false);
+    
+    // A site that keeps faulting is pinned and then skips the fast path
+    speculation::PinPolicy policy;
+    policy.min_attempts = 8;
+    policy.max_fault_ratio = 0.25;
+    speculation::Site site("test.speculate.pin", policy);
+    fast_runs = 0;
+    slow_runs = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        const int* data = (i % 2) ? nullptr : values;
+        int result = speculation::speculate(site,
+            [&] { ++fast_runs; return sumUnchecked(data, 4); },
+            [&] { ++slow_runs; return data ? 10 : -1; });
+        REQUIRE(result == (data ? 10 : -1));
+    }
+    REQUIRE(site.pinned());
+    REQUIRE(fast_runs == 8);
+    REQUIRE(slow_runs == 96);
+    
+    std::vector<speculation::SiteStats> stats = speculation::siteStats();
+    auto entry = std::find_if(stats.begin(), stats.end(), [](const speculation::SiteStats& s) {
+        return s.name == "test.speculate.pin";
+    });
+    REQUIRE(entry != stats.end());
+    REQUIRE(entry->attempts == 8);
+    REQUIRE(entry->faults == 4);
+    REQUIRE(entry->slow_runs == 96);
+    REQUIRE(entry->pinned);
+    
+    // Unpinning starts the site over
+    REQUIRE(speculation::unpinSite("test.speculate.pin"));
+    REQUIRE_FALSE(site.pinned());
+    REQUIRE(speculation::speculate(site, [&] { return sumUnchecked(values, 4); }, [] { return -1; }) == 10);
+    REQUIRE(site.pinned() == false);
+    REQUIRE_FALSE(speculation::unpinSite("test.speculate.missing"));
+}
+
+// Test case for adaptive(): strategy switching on the decayed fault rate
+TEST_CASE("Adaptive sites switch between catching and validation with hysteresis", "[try_catch_guard][speculate]") {
+    using namespace try_catch_guard;
+    
+    const int values[] = { 1, 2, 3, 4 };
+    speculation::AdaptivePolicy policy;
+    policy.decay_shift = 3;
+    policy.enter_validation = 0.25;
+    policy.leave_validation = 0.05;
+    speculation::AdaptiveSite site("test.adaptive", policy);
+    
+    int validations = 0;
+    auto call = [&](const int* data) {
+        return speculation::adaptive(site,
+            [&] { ++validations; return data != nullptr; },
+            [&] { return sumUnchecked(data, 4); },
+            [] { return -1; });
+    };
+    
+    // Faults are caught without validating while the rate is low
+    REQUIRE(call(values) == 10);
+    REQUIRE(call(nullptr) == -1);
+    REQUIRE_FALSE(site.validating());
+    REQUIRE(validations == 0);
+    
+    // A burst of faults switches the site to validation
+    int calls = 0;
+    while (!site.validating() && calls < 100)
+    {
+        REQUIRE(call(nullptr) == -1);
+        ++calls;
+    }
+    REQUIRE(site.validating());
+    REQUIRE(site.faultRate() > policy.enter_validation);
+    
+    // Rejected inputs keep the rate up; the block does not run on them
+    REQUIRE(call(nullptr) == -1);
+    REQUIRE(call(values) == 10);
+    REQUIRE(validations == 2);
+    REQUIRE(site.validating());
+    
+    // Hysteresis: below the entry threshold but above the exit one, the site keeps validating
+    while (site.faultRate() > policy.enter_validation) {
+        REQUIRE(call(values) == 10);
+    }
+    REQUIRE(site.validating());
+    
+    // Good inputs decay the rate until the site goes back to catching
+    calls = 0;
+    while (site.validating() && calls < 100)
+    {
+        REQUIRE(call(values) == 10);
+        ++calls;
+    }
+    REQUIRE_FALSE(site.validating());
+    REQUIRE(site.faultRate() < policy.leave_validation);
+    
+    // The rate decays to exactly zero, after which a success costs one load
+    for (int i = 0; i < 100; ++i) {
+        call(values);
+    }
+    REQUIRE(site.faultRate() == 0.0);
+    
+    std::vector<speculation::AdaptiveSiteStats> stats = speculation::adaptiveSiteStats();
+    auto entry = std::find_if(stats.begin(), stats.end(), [](const speculation::AdaptiveSiteStats& s) {
+        return s.name == "test.adaptive";
+    });
+    REQUIRE(entry != stats.end());
+    REQUIRE(entry->switches == 2);
+    REQUIRE(entry->rejections == 1);
+    REQUIRE(entry->faults >= 2);
+    REQUIRE_FALSE(entry->validating);
+    
+    site.reset();
+    REQUIRE(site.faultRate() == 0.0);
+}
+
+namespace {
+
+double threadCpuSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) / 1e9;
+}
+
+// Burns `seconds` of the thread's CPU time
+__attribute__((noinline)) void spinProfiledWork(double seconds)
+{
+    volatile std::uint64_t sink = 0;
+    double end = threadCpuSeconds() + seconds;
+    while (threadCpuSeconds() < end)
+    {
+        for (int i = 0; i < 10000; ++i) {
+            sink = sink + static_cast<std::uint64_t>(i);
+        }
+    }
+}
+
+} // namespace
+
+// Test case for the sampling profiler and its safe stack walk
+TEST_CASE("Sampling profiler records guarded stacks and contains bad frame pointers", "[try_catch_guard][profiler]") {
+    using namespace try_catch_guard;
+    
+    // A frame chain that leads into an unreadable page ends the walk without a crash
+    std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    char* pages = static_cast<char*>(mmap(nullptr, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    REQUIRE(pages != MAP_FAILED);
+    REQUIRE(mprotect(pages + page_size, page_size, PROT_NONE) == 0);
+    std::uintptr_t* records = reinterpret_cast<std::uintptr_t*>(pages);
+    records[0] = reinterpret_cast<std::uintptr_t>(&records[8]);
+    records[1] = 0x1111;
+    records[8] = reinterpret_cast<std::uintptr_t>(pages + page_size);
+    records[9] = 0x2222;
+    
+    std::uintptr_t pcs[8] = {};
+    std::uint64_t recovered = getRecoveredFaultCount();
+    REQUIRE(profiler::walkFramePointers(records, pcs, 8) == 2);
+    REQUIRE(pcs[0] == 0x1111);
+    REQUIRE(pcs[1] == 0x2222);
+    REQUIRE(getRecoveredFaultCount() == recovered + 1);
+    
+    // A chain that goes back down the stack is cut
+    records[8] = reinterpret_cast<std::uintptr_t>(&records[0]);
+    REQUIRE(profiler::walkFramePointers(records, pcs, 8) == 2);
+    munmap(pages, 2 * page_size);
+    
+    // Guarded CPU time on two threads, one registered after the start
+    profiler::ProfilerOptions options;
+    options.frequency = 1000;
+    REQUIRE(profiler::start(options));
+    REQUIRE_FALSE(profiler::start(options));
+    REQUIRE(profiler::isRunning());
+    
+    std::thread worker([] {
+        _try {
+            spinProfiledWork(0.2);
+        }
+        _catch(InvalidMemoryAccessException, e) {
+        }
+        unregisterThreadHandler();
+    });
+    _try {
+        spinProfiledWork(0.2);
+    }
+    _catch(InvalidMemoryAccessException, e) {
+    }
+    worker.join();
+    
+    profiler::stop();
+    REQUIRE_FALSE(profiler::isRunning());
+    
+    profiler::ProfilerStats stats = profiler::getStats();
+    REQUIRE(stats.samples > 0);
+    REQUIRE(stats.guarded_samples > 0);
+    REQUIRE(stats.stacks > 0);
+    REQUIRE(stats.armed_threads == 0);
+    
+    // Collapsed stacks: "frame;frame;... count", with the guards as frames
+    std::string collapsed = profiler::collapsedStacks();
+    REQUIRE(collapsed.find("[guard]") != std::string::npos);
+    std::uint64_t total = 0;
+    std::size_t begin = 0;
+    while (begin < collapsed.size())
+    {
+        std::size_t end = collapsed.find('\n', begin);
+        REQUIRE(end != std::string::npos);
+        std::string line = collapsed.substr(begin, end - begin);
+        std::size_t space = line.rfind(' ');
+        REQUIRE(space != std::string::npos);
+        total += std::stoull(line.substr(space + 1));
+        begin = end + 1;
+    }
+    REQUIRE(total == stats.samples - stats.dropped_samples);
+}
+
+// Test case for range hooks and write-tracked regions
+TEST_CASE("Write-tracked regions copy only the pages written since the last checkpoint", "[try_catch_guard][tracking]") {
+    using namespace try_catch_guard;
+    using ResultGuard = basic_guard<policy::result_on_fault>;
+    
+    // A range hook sees faults outside of any guard and can resume them
+    long page_size = sysconf(_SC_PAGESIZE);
+    void* page = mmap(nullptr, page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(page != MAP_FAILED);
+    REQUIRE(addRangeFaultHook(page, page_size, unprotectHook, page));
+    static_cast<volatile int*>(page)[1] = 3;
+    REQUIRE(static_cast<int*>(page)[1] == 3);
+    REQUIRE(removeRangeFaultHook(page));
+    REQUIRE_FALSE(removeRangeFaultHook(page));
+    
+    // Continue passes the fault on to the guard
+    HookRecord range_record;
+    mprotect(page, page_size, PROT_NONE);
+    REQUIRE(addRangeFaultHook(page, page_size, recordingHook, &range_record));
+    GuardResult passed = ResultGuard::run([&] {
+        static_cast<volatile int*>(page)[0] = 1;
+    });
+    REQUIRE(passed.faulted());
+    REQUIRE(passed.address == page);
+    REQUIRE(range_record.calls == 1);
+    REQUIRE(removeRangeFaultHook(page));
+    munmap(page, page_size);
+    
+    // The first checkpoint copies every page
+    WriteTrackedRegion region(8 * page_size - 100);
+    REQUIRE(region.pageCount() == 8);
+    REQUIRE(region.size() == static_cast<std::size_t>(8 * page_size));
+    REQUIRE(region.dirtyPageCount() == 8);
+    std::vector<char> snapshot(region.size(), 'x');
+    REQUIRE(region.checkpoint(snapshot.data()) == 8);
+    REQUIRE(snapshot[0] == 0);
+    REQUIRE(region.dirtyPageCount() == 0);
+    
+    // First writes fault once per page and resume without unwinding,
+    // inside a guard, outside of one and in another thread
+    std::uint64_t recovered = getRecoveredFaultCount();
+    char* data = static_cast<char*>(region.data());
+    data[1 * page_size] = 'a';
+    data[1 * page_size + 1] = 'b';
+    GuardResult guarded = ResultGuard::run([&] {
+        data[2 * page_size + 5] = 'c';
+    });
+    REQUIRE_FALSE(guarded.faulted());
+    std::thread writer([&] {
+        data[6 * page_size + 7] = 'd';
+    });
+    writer.join();
+    REQUIRE(getRecoveredFaultCount() == recovered);
+    REQUIRE(region.stats().write_faults == 3);
+    REQUIRE(region.dirtyPageCount() == 3);
+    REQUIRE(region.isDirty(1));
+    REQUIRE_FALSE(region.isDirty(3));
+    
+    // The dirty pages are copied in two runs, one mprotect() each
+    std::uint64_t protect_calls = region.stats().protect_calls;
+    REQUIRE(region.checkpoint(snapshot.data()) == 3);
+    REQUIRE(region.stats().protect_calls == protect_calls + 2);
+    REQUIRE(region.stats().pages_copied == 11);
+    REQUIRE(std::memcmp(snapshot.data(), data, region.size()) == 0);
+    
+    // Written pages are protected again; untouched ones are not copied
+    data[2 * page_size] = 'e';
+    std::vector<std::size_t> offsets;
+    REQUIRE(region.checkpointRuns([&](std::size_t offset, const void* bytes, std::size_t size) {
+        offsets.push_back(offset);
+        REQUIRE(size == static_cast<std::size_t>(page_size));
+        REQUIRE(static_cast<const char*>(bytes)[0] == 'e');
+    }) == 1);
+    REQUIRE(offsets == std::vector<std::size_t>{ static_cast<std::size_t>(2 * page_size) });
+    REQUIRE(region.stats().write_faults == 4);
+    REQUIRE(region.stats().checkpoints == 3);
+    REQUIRE(region.stats().protect_failures == 0);
+    
+    // A run that cannot be protected (here its last page is unmapped, so
+    // mprotect() fails with ENOMEM) stays dirty for the next checkpoint
+    data[5 * page_size] = 'f';
+    data[6 * page_size] = 'g';
+    char* hole = data + 7 * page_size;
+    data[7 * page_size] = 'h';
+    REQUIRE(munmap(hole, page_size) == 0);
+    REQUIRE(region.checkpointRuns([](std::size_t, const void*, std::size_t) {}) == 3);
+    REQUIRE(region.stats().protect_failures == 1);
+    REQUIRE(region.dirtyPageCount() == 3);
+    REQUIRE(region.isDirty(5));
+    REQUIRE(region.isDirty(7));
+    REQUIRE(mmap(hole, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == hole);
+    REQUIRE(region.checkpoint(snapshot.data()) == 3);
+    REQUIRE(snapshot[6 * page_size] == 'g');
+    REQUIRE(region.stats().protect_failures == 1);
+    REQUIRE(region.dirtyPageCount() == 0);
+}
+
+// Test case for page-level rollback of faulting transactions
+TEST_CASE("Rollback regions restore every page written by a faulting block", "[try_catch_guard][tracking]") {
+    using namespace try_catch_guard;
+    
+    long page_size = sysconf(_SC_PAGESIZE);
+    RollbackRegion table(4 * page_size);
+    REQUIRE(table.size() == static_cast<std::size_t>(4 * page_size));
+    int* values = static_cast<int*>(table.data());
+    const std::size_t per_page = page_size / sizeof(int);
+    const std::size_t count = table.size() / sizeof(int);
+    
+    // Outside of a transaction the region is ordinary memory
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = static_cast<int>(i);
+    }
+    REQUIRE(table.stats().pages_saved == 0);
+    
+    // A fault after writing two pages: both are restored before _catch
+    bool caught = false;
+    _try_rollback(table) {
+        REQUIRE(table.inTransaction());
+        values[0] = -1;
+        values[1] = -1;
+        values[2 * per_page + 3] = -1;
+        int* ptr = nullptr;
+        *ptr = 1;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        caught = true;
+        REQUIRE_FALSE(table.inTransaction());
+        REQUIRE(values[0] == 0);
+        REQUIRE(values[1] == 1);
+        REQUIRE(values[2 * per_page + 3] == static_cast<int>(2 * per_page + 3));
+    }
+    REQUIRE(caught);
+    tracking::RollbackStats stats = table.stats();
+    REQUIRE(stats.transactions == 1);
+    REQUIRE(stats.rollbacks == 1);
+    REQUIRE(stats.pages_saved == 2);
+    REQUIRE(stats.pages_restored == 2);
+    
+    // A block that returns keeps its writes
+    _try_rollback(table) {
+        values[3 * per_page] = 42;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        FAIL("unexpected fault");
+    }
+    REQUIRE(values[3 * per_page] == 42);
+    REQUIRE(table.stats().rollbacks == 1);
+    
+    // C++ exceptions roll back too and propagate unchanged
+    REQUIRE_THROWS_AS(table.transaction([&] {
+        values[per_page] = -1;
+        throw std::runtime_error("abort");
+    }), std::runtime_error);
+    REQUIRE(values[per_page] == static_cast<int>(per_page));
+    
+    // Transactions on one region do not nest; the outer one rolls back
+    REQUIRE_THROWS_AS(table.transaction([&] {
+        values[0] = -1;
+        table.transaction([] {});
+    }), std::logic_error);
+    REQUIRE(values[0] == 0);
+    
+    // Writes after the transaction do not fault
+    std::uint64_t saved = table.stats().pages_saved;
+    values[0] = 5;
+    REQUIRE(table.stats().pages_saved == saved);
+    
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        if (i != 3 * per_page && values[i] != static_cast<int>(i)) {
+            FAIL("value " << i << " was not restored");
+        }
+    }
+}
+
+// Test case for the undo log of _try_tx and policy::undo_log
+TEST_CASE("Undo-logged guards replay tx_write in reverse on faults and throws", "[try_catch_guard][tx]") {
+    using namespace try_catch_guard;
+    
+    int values[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    struct Pair { double x; double y; } pair = { 1.5, 2.5 };
+    
+    // Outside of a transaction tx_write only writes
+    tx_write(&values[7], 70);
+    REQUIRE(values[7] == 70);
+    values[7] = 7;
+    
+    // A fault undoes every logged write before _catch, newest first
+    bool caught = false;
+    _try_tx {
+        tx_write(&values[1], 10);
+        tx_write(&values[5], 50);
+        tx_write(&values[1], 11); // Written twice: the oldest value wins
+        tx_write(&pair, Pair{ -1.0, -2.0 });
+        int* ptr = nullptr;
+        *ptr = 1;
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        caught = true;
+        REQUIRE(values[1] == 1);
+        REQUIRE(values[5] == 5);
+        REQUIRE(pair.x == 1.5);
+        REQUIRE(pair.y == 2.5);
+    }
+    REQUIRE(caught);
+    
+    // A block that returns keeps its writes
+    _try_tx {
+        tx_write(&values[2], 20);
+    }
+    _catch(InvalidMemoryAccessException, e) {
+        FAIL("unexpected fault");
+    }
+    REQUIRE(values[2] == 20);
+    
+    // C++ exceptions undo the writes and propagate
+    REQUIRE_THROWS_AS(tx_guard::run([&] {
+        tx_write(&values[3], 30);
+        throw std::runtime_error("abort");
+    }), std::runtime_error);
+    REQUIRE(values[3] == 3);
+    
+    // A nested guard that faults undoes only its own writes; one that
+    // returns is undone with the enclosing guard
+    using ResultTx = basic_guard<policy::result_on_fault, policy::undo_log>;
+    GuardResult outer = ResultTx::run([&] {
+        tx_write(&values[4], 40);
+        GuardResult inner = ResultTx::run([&] {
+            tx_write(&values[4], 41);
+            tx_write(&values[6], 60);
+            int* ptr = nullptr;
+            *ptr = 1;
+        });
+        REQUIRE(inner.faulted());
+        REQUIRE(values[4] == 40);
+        REQUIRE(values[6] == 6);
+        
+        ResultTx::run([&] { tx_write(&values[6], 61); });
+        REQUIRE(values[6] == 61);
+        int* ptr = nullptr;
+        *ptr = 1;
+    });
+    REQUIRE(outer.faulted());
+    REQUIRE(values[4] == 4);
+    REQUIRE(values[6] == 6);
+    
+    // Filling the log throws std::length_error and undoes what was logged
+    REQUIRE_THROWS_AS(tx_guard::run([&] {
+        for (std::size_t i = 0; i <= UndoLog::max_entries; ++i) {
+            tx_write(&values[0], static_cast<int>(i) + 100);
+        }
+    }), std::length_error);
+    REQUIRE(values[0] == 0);
+    REQUIRE(currentThreadContext->undo_log->depth == 0);
+    REQUIRE(currentThreadContext->undo_log->count == 0);
+    
+    // The log starts small and grew to its limit; the footprint reports it
+    REQUIRE(currentThreadContext->undo_log->capacity == UndoLog::max_entries);
+    std::size_t undo_bytes = getMemoryFootprint().undo_log_bytes;
+    REQUIRE(undo_bytes >= sizeof(UndoLog) + UndoLog::max_entries * sizeof(UndoLog::Entry));
+    std::size_t fresh_log_bytes = 0;
+    std::thread fresh([&] {
+        tx_guard::run([&] { tx_write(&values[1], 10); });
+        fresh_log_bytes = getMemoryFootprint().undo_log_bytes - undo_bytes;
+    });
+    fresh.join();
+    REQUIRE(fresh_log_bytes == sizeof(UndoLog) + UndoLog::initial_capacity * sizeof(UndoLog::Entry));
+    REQUIRE(getMemoryFootprint().undo_log_bytes == undo_bytes);
+}
+
+// Test case for page-access recording and prefetch replay
+TEST_CASE("Access recorder logs first touches and the replay prefetches them in order", "[try_catch_guard][prefetch]") {
+    using namespace try_catch_guard;
+    using ResultGuard = basic_guard<policy::result_on_fault>;
+    
+    // A 16-page file mapped read-only
+    long page_size = sysconf(_SC_PAGESIZE);
+    char data_path[] = "/tmp/tcg_prefetch_dataXXXXXX";
+    int fd = mkstemp(data_path);
+    REQUIRE(fd >= 0);
+    std::vector<char> contents(16 * page_size);
+    for (std::size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<char>(i / page_size + 1);
+    }
+    REQUIRE(write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()));
+    void* mapping = mmap(nullptr, contents.size(), PROT_READ, MAP_PRIVATE, fd, 0);
+    REQUIRE(mapping != MAP_FAILED);
+    const volatile char* pages = static_cast<const char*>(mapping);
+    
+    // First touches are logged once each, in order, from any thread
+    std::uint64_t recovered = getRecoveredFaultCount();
+    prefetch::AccessRecorder recorder(mapping, contents.size());
+    REQUIRE(pages[5 * page_size] == 6);
+    REQUIRE(pages[5 * page_size + 1] == 6);
+    GuardResult guarded = ResultGuard::run([&] {
+        REQUIRE(pages[2 * page_size] == 3);
+    });
+    REQUIRE_FALSE(guarded.faulted());
+    std::thread reader([&] {
+        REQUIRE(pages[9 * page_size] == 10);
+    });
+    reader.join();
+    for (int page = 10; page < 13; ++page) {
+        REQUIRE(pages[page * page_size] == page + 1);
+    }
+    REQUIRE(recorder.touchedPages() == 6);
+    REQUIRE(getRecoveredFaultCount() == recovered);
+    
+    // A write to a touched read-only page is still a fault of the program
+    GuardResult written = ResultGuard::run([&] {
+        const_cast<char*>(const_cast<const char*>(pages))[5 * page_size] = 0;
+    });
+    REQUIRE(written.faulted());
+    
+    char trace_path[] = "/tmp/tcg_prefetch_traceXXXXXX";
+    int trace_fd = mkstemp(trace_path);
+    REQUIRE(trace_fd >= 0);
+    close(trace_fd);
+    REQUIRE(recorder.writeTrace(trace_path));
+    REQUIRE_FALSE(recorder.recording());
+    REQUIRE(pages[15 * page_size] == 16); // Accessible again
+    std::vector<std::uint32_t> expected = { 5, 2, 9, 10, 11, 12 };
+    REQUIRE(recorder.trace() == expected);
+    REQUIRE(prefetch::readTrace(trace_path) == expected);
+    
+    // The replay coalesces the run 9-12 into one call
+    prefetch::TraceReplay replay(trace_path, mapping, contents.size());
+    REQUIRE(replay.loaded());
+    replay.start();
+    replay.wait();
+    prefetch::ReplayStats stats = replay.stats();
+    REQUIRE(stats.pages == 6);
+    REQUIRE(stats.issued == 6);
+    REQUIRE(stats.calls == 3);
+    
+    // readahead() on the file; pages outside of a smaller mapping are dropped
+    prefetch::ReplayOptions options;
+    options.fd = fd;
+    options.max_batch = 2;
+    prefetch::TraceReplay file_replay(trace_path, mapping, 10 * page_size, options);
+    file_replay.start();
+    file_replay.wait();
+    REQUIRE(file_replay.stats().pages == 3);
+    REQUIRE(file_replay.stats().calls == 3);
+    
+    // A missing trace replays nothing
+    prefetch::TraceReplay missing("/nonexistent/trace", mapping, contents.size());
+    REQUIRE_FALSE(missing.loaded());
+    missing.start();
+    REQUIRE(missing.stats().issued == 0);
+    
+    munmap(mapping, contents.size());
+    close(fd);
+    unlink(data_path);
+    unlink(trace_path);
+}
+
+// Test case for compressed memory regions and their codec
+TEST_CASE("Compressed regions decompress pages on first access and compact cold ones", "[try_catch_guard][compression]") {
+    using namespace try_catch_guard;
+    using ResultGuard = basic_guard<policy::result_on_fault>;
+    
+    // The codec round-trips zeros, repetitive and random data
+    std::vector<unsigned char> input(4096);
+    std::vector<unsigned char> packed(4096);
+    std::vector<unsigned char> output(4096);
+    std::mt19937 random(7);
+    for (int kind = 0; kind < 3; ++kind)
+    {
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            input[i] = kind == 0 ? 0 : kind == 1 ? static_cast<unsigned char>(i % 13) : static_cast<unsigned char>(random());
+        }
+        std::size_t size = compression::compressBlock(input.data(), input.size(), packed.data(), packed.size());
+        if (kind == 2) {
+            REQUIRE(size == 0); // Random data does not fit in a page
+            continue;
+        }
+        REQUIRE(size > 0);
+        REQUIRE(size < 64);
+        REQUIRE(compression::decompressBlock(packed.data(), size, output.data(), output.size()) == input.size());
+        REQUIRE(output == input);
+        REQUIRE(compression::decompressBlock(packed.data(), size, output.data(), 100) == 0);
+    }
+    
+    // 32 pages: a table of runs and one random page
+    compression::CompressedRegion region(32 * 4096);
+    std::size_t page_size = region.pageSize();
+    std::size_t count = region.size() / sizeof(std::uint32_t);
+    std::uint32_t* table = static_cast<std::uint32_t*>(region.data());
+    for (std::size_t i = 0; i < count; ++i) {
+        table[i] = static_cast<std::uint32_t>(i / 64);
+    }
+    unsigned char* noise = static_cast<unsigned char*>(region.data()) + 3 * page_size;
+    for (std::size_t i = 0; i < page_size; ++i) {
+        noise[i] = static_cast<unsigned char>(random());
+    }
+    std::vector<unsigned char> noise_copy(noise, noise + page_size);
+    
+    region.compactAll();
+    compression::CompressedRegionStats stats = region.stats();
+    REQUIRE(stats.compressed_pages == stats.pages);
+    REQUIRE(stats.resident_pages == 0);
+    REQUIRE(stats.compressions == stats.pages);
+    REQUIRE(stats.compressed_bytes < region.size() / 4);
+    
+    // Reads decompress their page once, from any thread, inside a guard or not
+    std::uint64_t recovered = getRecoveredFaultCount();
+    const volatile std::uint32_t* values = table;
+    REQUIRE(values[5] == 0);
+    REQUIRE(values[640] == 10);
+    std::thread reader([&] {
+        REQUIRE(values[count - 1] == (count - 1) / 64);
+    });
+    reader.join();
+    GuardResult guarded = ResultGuard::run([&] {
+        REQUIRE(std::equal(noise_copy.begin(), noise_copy.end(), noise));
+    });
+    REQUIRE_FALSE(guarded.faulted());
+    REQUIRE(region.stats().decompressions == 3);
+    REQUIRE(region.stats().resident_pages == 3);
+    REQUIRE(getRecoveredFaultCount() == recovered);
+    
+    // Clean pages reuse their compression; written pages are compressed again
+    table[2 * page_size / 4] = 4242;
+    region.compactAll();
+    stats = region.stats();
+    REQUIRE(stats.compressed_pages == stats.pages);
+    REQUIRE(stats.compressions == stats.pages + 1);
+    REQUIRE(values[2 * page_size / 4] == 4242);
+    REQUIRE(values[0] == 0);
+    
+    // A read-only region faults on writes to its pages
+    compression::CompressedRegionOptions read_only;
+    read_only.writable = false;
+    compression::CompressedRegion constants(4 * page_size, read_only);
+    static_cast<char*>(constants.data())[page_size] = 9;
+    constants.compactAll();
+    volatile char* bytes = static_cast<char*>(constants.data());
+    REQUIRE(bytes[page_size] == 9);
+    GuardResult written = ResultGuard::run([&] {
+        bytes[page_size] = 1;
+    });
+    REQUIRE(written.faulted());
+    REQUIRE(bytes[page_size] == 9);
+    
+    // Reads racing with compaction retry, again and again at the same
+    // address; none is reported as a fault
+    std::atomic<bool> compacting(true);
+    std::atomic<int> false_faults(0);
+    std::atomic<int> wrong_values(0);
+    std::vector<std::thread> racers;
+    for (int t = 0; t < 4; ++t)
+    {
+        racers.emplace_back([&] {
+            while (compacting.load())
+            {
+                GuardResult read = ResultGuard::run([&] {
+                    if (bytes[page_size] != 9) {
+                        wrong_values.fetch_add(1);
+                    }
+                });
+                if (read.faulted()) {
+                    false_faults.fetch_add(1);
+                }
+            }
+        });
+    }
+    // Bounded by time: the race window is narrow and runs are slow under ASan
+    auto race_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < race_end)
+    {
+        constants.compactAll();
+        std::this_thread::yield();
+    }
+    compacting.store(false);
+    for (std::thread& racer : racers) {
+        racer.join();
+    }
+    REQUIRE(false_faults.load() == 0);
+    REQUIRE(wrong_values.load() == 0);
+    
+    // The compactor protects what it passes and compresses it on the next pass
+    REQUIRE(region.stats().resident_pages == 2); // Pages 0 and 2
+    compression::CompactorOptions options;
+    options.interval_ms = 1;
+    options.pages_per_step = 8;
+    region.startCompactor(options);
+    for (int i = 0; i < 2000 && region.stats().resident_pages != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    region.stopCompactor();
+    REQUIRE(region.stats().resident_pages == 0);
+    REQUIRE(values[700] == 10);
+}